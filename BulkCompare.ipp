@@ -0,0 +1,239 @@
+// Author: Hakan Yıldız
+// Shared under MIT License. See the file LICENSE for more info.
+
+/// @file BulkCompare.ipp
+/// Implements a vectorized pre-pass that finds the longest common prefix of two
+/// buffers which only contains printable ASCII characters, spaces and newlines.
+/// Such a prefix tokenizes identically on both sides under the rules of
+/// diff_checker_char.cpp, so the token-level comparison can start after it.
+/// The implementation (AVX2, SSE2, NEON or scalar) is chosen at runtime.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #include <immintrin.h>
+    #define BULK_COMPARE_X86
+#elif defined(__ARM_NEON)
+    #include <arm_neon.h>
+    #define BULK_COMPARE_NEON
+#endif
+
+using std::size_t;
+using std::uint64_t;
+
+/// Whether a byte may be part of a prefix found by printablePrefix().
+inline bool isBulkPrintable(char c)
+{
+    return (' ' <= c && c <= '~') || c == '\n';
+}
+
+/// The scalar implementation of printablePrefix(), which starts at the given
+/// offset and also finishes the vectorized implementations.
+inline size_t printablePrefixScalar(const char *a, const char *b, size_t n,
+                                    size_t i, uint64_t &newlines)
+{
+    for (; i < n; i++)
+    {
+        if (a[i] != b[i] || !isBulkPrintable(a[i]))
+        {
+            break;
+        }
+
+        newlines += (a[i] == '\n');
+    }
+
+    return i;
+}
+
+#ifdef BULK_COMPARE_X86
+
+/// The SSE2 implementation of printablePrefix(), using 32-byte blocks.
+__attribute__((target("sse2")))
+inline size_t printablePrefixSse2(const char *a, const char *b, size_t n,
+                                  uint64_t &newlines)
+{
+    const __m128i low = _mm_set1_epi8(' ' - 1);
+    const __m128i high = _mm_set1_epi8('~' + 1);
+    const __m128i newline = _mm_set1_epi8('\n');
+
+    size_t i = 0;
+
+    for (; i + 32 <= n; i += 32)
+    {
+        unsigned okMask = 0;
+        unsigned newlineMask = 0;
+
+        for (size_t half = 0; half < 32; half += 16)
+        {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i + half));
+            __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i + half));
+            __m128i nl = _mm_cmpeq_epi8(x, newline);
+            __m128i valid = _mm_or_si128(_mm_and_si128(_mm_cmpgt_epi8(x, low),
+                                                       _mm_cmplt_epi8(x, high)),
+                                         nl);
+            __m128i ok = _mm_and_si128(_mm_cmpeq_epi8(x, y), valid);
+
+            okMask |= static_cast<unsigned>(_mm_movemask_epi8(ok)) << half;
+            newlineMask |= static_cast<unsigned>(_mm_movemask_epi8(nl)) << half;
+        }
+
+        if (okMask != 0xFFFFFFFFu)
+        {
+            break;
+        }
+
+        newlines += static_cast<unsigned>(__builtin_popcount(newlineMask));
+    }
+
+    return printablePrefixScalar(a, b, n, i, newlines);
+}
+
+/// The AVX2 implementation of printablePrefix(), using 64-byte blocks.
+__attribute__((target("avx2")))
+inline size_t printablePrefixAvx2(const char *a, const char *b, size_t n,
+                                  uint64_t &newlines)
+{
+    const __m256i low = _mm256_set1_epi8(' ' - 1);
+    const __m256i high = _mm256_set1_epi8('~' + 1);
+    const __m256i newline = _mm256_set1_epi8('\n');
+
+    size_t i = 0;
+
+    for (; i + 64 <= n; i += 64)
+    {
+        uint64_t okMask = 0;
+        uint64_t newlineMask = 0;
+
+        for (size_t half = 0; half < 64; half += 32)
+        {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i + half));
+            __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i + half));
+            __m256i nl = _mm256_cmpeq_epi8(x, newline);
+            __m256i valid = _mm256_or_si256(_mm256_and_si256(_mm256_cmpgt_epi8(x, low),
+                                                             _mm256_cmpgt_epi8(high, x)),
+                                            nl);
+            __m256i ok = _mm256_and_si256(_mm256_cmpeq_epi8(x, y), valid);
+
+            okMask |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(ok))) << half;
+            newlineMask |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(nl))) << half;
+        }
+
+        if (okMask != ~uint64_t(0))
+        {
+            break;
+        }
+
+        newlines += static_cast<uint64_t>(__builtin_popcountll(newlineMask));
+    }
+
+    return printablePrefixScalar(a, b, n, i, newlines);
+}
+
+#endif
+
+#ifdef BULK_COMPARE_NEON
+
+/// The NEON implementation of printablePrefix(), using 32-byte blocks.
+inline size_t printablePrefixNeon(const char *a, const char *b, size_t n,
+                                  uint64_t &newlines)
+{
+    const uint8x16_t low = vdupq_n_u8(' ');
+    const uint8x16_t high = vdupq_n_u8('~');
+    const uint8x16_t newline = vdupq_n_u8('\n');
+    const uint8x16_t one = vdupq_n_u8(1);
+
+    size_t i = 0;
+
+    for (; i + 32 <= n; i += 32)
+    {
+        uint8x16_t ok = vdupq_n_u8(0xFF);
+        uint8x16_t count = vdupq_n_u8(0);
+
+        for (size_t half = 0; half < 32; half += 16)
+        {
+            uint8x16_t x = vld1q_u8(reinterpret_cast<const uint8_t *>(a + i + half));
+            uint8x16_t y = vld1q_u8(reinterpret_cast<const uint8_t *>(b + i + half));
+            uint8x16_t nl = vceqq_u8(x, newline);
+            uint8x16_t valid = vorrq_u8(vandq_u8(vcgeq_u8(x, low), vcleq_u8(x, high)), nl);
+
+            ok = vandq_u8(ok, vandq_u8(vceqq_u8(x, y), valid));
+            count = vaddq_u8(count, vandq_u8(nl, one));
+        }
+
+        if (vminvq_u8(ok) != 0xFF)
+        {
+            break;
+        }
+
+        newlines += vaddvq_u8(count);
+    }
+
+    return printablePrefixScalar(a, b, n, i, newlines);
+}
+
+#endif
+
+/// Finds the longest common prefix of two buffers that only contains printable
+/// ASCII characters, spaces and newlines.
+/// @param a The first buffer.
+/// @param b The second buffer.
+/// @param n The number of bytes available in both buffers.
+/// @param newlines Set to the number of newlines in the prefix.
+/// @return The length of the prefix.
+inline size_t printablePrefix(const char *a, const char *b, size_t n,
+                              uint64_t &newlines)
+{
+    newlines = 0;
+
+#if defined(BULK_COMPARE_X86)
+    static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+    static const bool hasSse2 = __builtin_cpu_supports("sse2");
+
+    if (hasAvx2)
+    {
+        return printablePrefixAvx2(a, b, n, newlines);
+    }
+    else if (hasSse2)
+    {
+        return printablePrefixSse2(a, b, n, newlines);
+    }
+#elif defined(BULK_COMPARE_NEON)
+    return printablePrefixNeon(a, b, n, newlines);
+#endif
+
+    return printablePrefixScalar(a, b, n, 0, newlines);
+}
+
+/// Finds how much of two buffers can be skipped before tokenizing them under
+/// the rules of diff_checker_char.cpp. This is the part of printablePrefix()
+/// that ends right after a newline which is followed by one more common byte,
+/// so that the newline is known not to precede the end of any file.
+/// @param a The first buffer.
+/// @param b The second buffer.
+/// @param n The number of bytes available in both buffers.
+/// @param newlines Set to the number of newlines in the skippable part.
+/// @return The length of the skippable part.
+inline size_t skippablePrefix(const char *a, const char *b, size_t n,
+                              uint64_t &newlines)
+{
+    size_t length = printablePrefix(a, b, n, newlines);
+
+    if (length == 0)
+    {
+        return 0;
+    }
+
+    // Drop the last byte of the prefix, and then the incomplete last line.
+    newlines -= (a[length - 1] == '\n');
+    length--;
+
+    while (length > 0 && a[length - 1] != '\n')
+    {
+        length--;
+    }
+
+    return length;
+}
@@ -0,0 +1,232 @@
+// Author: Hakan Yıldız
+// Shared under MIT License. See the file LICENSE for more info.
+
+/// @file CheckerStats.ipp
+/// Implements the instrumentation of the checkers, which is compiled in only if
+/// the CHECKER_STATS macro is defined. Otherwise, the counters and timers are
+/// empty classes whose calls compile to nothing, so that the instrumented code
+/// costs nothing in production builds.
+///
+/// When compiled in, a checker writes a single line to the standard error after
+/// each test case (see diff_checker_main in diff_checker_base.ipp):
+///     {"checkerStats": {"bytesMapped": ..., "bytesRead": ..., ...}}
+/// with the following counters for the test case:
+/// - bytesMapped: The bytes of the memory-mapped input files.
+/// - bytesRead: The bytes read from the input files that are not mapped.
+/// - peakBufferBytes: The largest buffer for the bytes read.
+/// - validTokens, spaceTokens, newlineTokens: The tokens parsed, by kind. The
+///   bytes that are skipped in bulk (e.g., an equal prefix) are not parsed.
+/// - parseSeconds: The time spent parsing tokens, summed over the threads.
+/// - outputSeconds: The time spent formatting the output upon a mismatch.
+/// - compareSeconds: The rest of the time spent on the test case, i.e., opening
+///   and comparing the files.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+using std::uint64_t;
+
+#ifdef CHECKER_STATS
+    /// Whether the instrumentation is compiled in.
+    constexpr bool CheckerStatsEnabled = true;
+#else
+    /// Whether the instrumentation is compiled in.
+    constexpr bool CheckerStatsEnabled = false;
+#endif
+
+/// The counters of a test case, which can be added to from many threads.
+struct CheckerStats
+{
+    std::atomic<uint64_t> bytesMapped {0};       ///< See CheckerStats.ipp.
+    std::atomic<uint64_t> bytesRead {0};         ///< See CheckerStats.ipp.
+    std::atomic<uint64_t> peakBufferBytes {0};   ///< See CheckerStats.ipp.
+    std::atomic<uint64_t> validTokens {0};       ///< See CheckerStats.ipp.
+    std::atomic<uint64_t> spaceTokens {0};       ///< See CheckerStats.ipp.
+    std::atomic<uint64_t> newlineTokens {0};     ///< See CheckerStats.ipp.
+    std::atomic<uint64_t> parseNanoseconds {0};  ///< See CheckerStats.ipp.
+    std::atomic<uint64_t> outputNanoseconds {0}; ///< See CheckerStats.ipp.
+    std::atomic<uint64_t> totalNanoseconds {0};  ///< The time of the test case.
+
+    /// Resets the counters for a new test case.
+    void reset()
+    {
+        for (std::atomic<uint64_t> *counter : {&bytesMapped, &bytesRead, &peakBufferBytes,
+                                               &validTokens, &spaceTokens, &newlineTokens,
+                                               &parseNanoseconds, &outputNanoseconds,
+                                               &totalNanoseconds})
+        {
+            counter->store(0, std::memory_order_relaxed);
+        }
+    }
+
+    /// Raises peakBufferBytes to a buffer size, if it is larger.
+    void raisePeakBuffer(uint64_t bytes)
+    {
+        uint64_t peak = peakBufferBytes.load(std::memory_order_relaxed);
+
+        while (peak < bytes &&
+               !peakBufferBytes.compare_exchange_weak(peak, bytes, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    /// Writes the counters as the line in CheckerStats.ipp.
+    void write(std::ostream &output) const
+    {
+        auto seconds = [](uint64_t nanoseconds)
+        {
+            return static_cast<double>(nanoseconds) / 1e9;
+        };
+
+        uint64_t total = totalNanoseconds;
+        uint64_t parse = parseNanoseconds;
+        uint64_t format = outputNanoseconds;
+        uint64_t compare = total - std::min(total, parse + format);
+
+        output << "{\"checkerStats\": {"
+               << "\"bytesMapped\": " << bytesMapped
+               << ", \"bytesRead\": " << bytesRead
+               << ", \"peakBufferBytes\": " << peakBufferBytes
+               << ", \"validTokens\": " << validTokens
+               << ", \"spaceTokens\": " << spaceTokens
+               << ", \"newlineTokens\": " << newlineTokens
+               << ", \"parseSeconds\": " << seconds(parse)
+               << ", \"compareSeconds\": " << seconds(compare)
+               << ", \"outputSeconds\": " << seconds(format)
+               << "}}\n" << std::flush;
+    }
+};
+
+/// The counters of the current test case.
+inline CheckerStats checkerStats;
+
+/// A timer that adds the time it is in scope to a counter, if the
+/// instrumentation is compiled in.
+class CheckerStatsTimer
+{
+    private:
+        std::atomic<uint64_t> &mCounter;               ///< The counter.
+        std::chrono::steady_clock::time_point mStart; ///< The start time.
+        bool mIsStopped;                              ///< Whether stop() was called.
+
+    public:
+        /// Starts the timer.
+        /// @param counter The counter to add the time to, upon destruction.
+        explicit CheckerStatsTimer(std::atomic<uint64_t> &counter) :
+              mCounter(counter), mStart(), mIsStopped(false)
+        {
+            if constexpr (CheckerStatsEnabled)
+            {
+                mStart = std::chrono::steady_clock::now();
+            }
+        }
+
+        CheckerStatsTimer(const CheckerStatsTimer &) = delete;
+        CheckerStatsTimer & operator=(const CheckerStatsTimer &) = delete;
+
+        ~CheckerStatsTimer()
+        {
+            stop();
+        }
+
+        /// Adds the time so far to the counter, before the timer goes out of
+        /// scope. The timer does not add any more time afterwards.
+        void stop()
+        {
+            if constexpr (CheckerStatsEnabled)
+            {
+                if (mIsStopped)
+                {
+                    return;
+                }
+
+                mIsStopped = true;
+
+                auto elapsed = std::chrono::steady_clock::now() - mStart;
+
+                mCounter.fetch_add(static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()),
+                    std::memory_order_relaxed);
+            }
+        }
+};
+
+/// The token counters of a single tokenizer, which are added to checkerStats
+/// upon destruction, so that a tokenizer on another thread does not contend
+/// for them. Empty if the instrumentation is not compiled in.
+template<bool Enabled = CheckerStatsEnabled>
+class TokenizerStats
+{
+    public:
+        /// Counts a token of a kind. See the Token::Kind enumeration.
+        template<typename Kind>
+        void count(Kind)
+        {
+        }
+
+        /// Starts timing the parsing of a token.
+        void startParse()
+        {
+        }
+
+        /// Stops timing the parsing of a token.
+        void stopParse()
+        {
+        }
+};
+
+/// See TokenizerStats.
+template<>
+class TokenizerStats<true>
+{
+    private:
+        uint64_t mValid;   ///< The valid tokens so far.
+        uint64_t mSpace;   ///< The space tokens so far.
+        uint64_t mNewline; ///< The newline tokens so far.
+        uint64_t mParse;   ///< The nanoseconds of parsing so far.
+        std::chrono::steady_clock::time_point mStart; ///< The start of parsing.
+
+    public:
+        TokenizerStats() :
+              mValid(0), mSpace(0), mNewline(0), mParse(0), mStart()
+        {
+        }
+
+        TokenizerStats(const TokenizerStats &) = delete;
+        TokenizerStats & operator=(const TokenizerStats &) = delete;
+
+        ~TokenizerStats()
+        {
+            checkerStats.validTokens.fetch_add(mValid, std::memory_order_relaxed);
+            checkerStats.spaceTokens.fetch_add(mSpace, std::memory_order_relaxed);
+            checkerStats.newlineTokens.fetch_add(mNewline, std::memory_order_relaxed);
+            checkerStats.parseNanoseconds.fetch_add(mParse, std::memory_order_relaxed);
+        }
+
+        /// See TokenizerStats.
+        template<typename Kind>
+        void count(Kind kind)
+        {
+            mValid += (kind == Kind::Valid);
+            mSpace += (kind == Kind::Space);
+            mNewline += (kind == Kind::Newline);
+        }
+
+        /// See TokenizerStats.
+        void startParse()
+        {
+            mStart = std::chrono::steady_clock::now();
+        }
+
+        /// See TokenizerStats.
+        void stopParse()
+        {
+            mParse += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - mStart).count());
+        }
+};
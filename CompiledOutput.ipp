@@ -0,0 +1,428 @@
+// Author: Hakan Yıldız
+// Shared under MIT License. See the file LICENSE for more info.
+
+/// @file CompiledOutput.ipp
+/// Implements the compiled form of <correct_output_file>, i.e., its tokens as
+/// read by a Tokenizer, stored in a binary file that is memory-mapped and read
+/// by a CompiledTokenizer as the correct side of diff_checker_base.ipp. Hence,
+/// the ground truth is parsed and validated once, by diff_compile.cpp, rather
+/// than once per comparison.
+///
+/// The compiled file of <correct_output_file> is written next to it, with a
+/// suffix that names the tokenizer. It is in native byte order, and consists of
+/// a CompiledHeader followed by these sections, each aligned to 16 bytes:
+/// - kinds:  uint8_t[tokenCount], the Token::Kind of each token, which is one
+///           of Valid, Space and Newline. The end of the file is implied.
+/// - values: T[valueCount], the value of each Valid token.
+/// - lines:  CompiledLine[lineCount], the start of the line after each Newline
+///           token.
+/// The header holds the raw digest (see Digest.ipp) of <correct_output_file>,
+/// so that a compiled file is ignored once <correct_output_file> changes. It
+/// also holds the size and the modification time of <correct_output_file>, and
+/// while these match, the file is trusted without computing the raw digest,
+/// nor scanning the sections. The bytes of a compiled file depend only on
+/// <correct_output_file> and its stamp, e.g., the padding of long double values
+/// is zeroed.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "Input.ipp"
+#include "Tokenizer.ipp"
+
+using std::int64_t;
+using std::logic_error;
+using std::ofstream;
+using std::size_t;
+using std::string;
+using std::uint64_t;
+using std::uint8_t;
+using std::vector;
+
+/// The suffix of the compiled files for CharTokenizer.
+constexpr const char *CharCompiledSuffix = ".char.compiled";
+
+/// The suffix of the compiled files for RealTokenizer.
+constexpr const char *RealCompiledSuffix = ".real.compiled";
+
+/// The size and the modification time of a file, which change along with its
+/// bytes in practice.
+struct FileStamp
+{
+    uint64_t size;     ///< The size of the file.
+    int64_t modified;  ///< The modification time, in nanoseconds.
+
+    /// Reads the stamp of the file at a given path.
+    /// @return Whether the file is a regular file whose stamp could be read.
+    bool read(const char *path)
+    {
+        struct stat info;
+
+        if (stat(path, &info) != 0 || !S_ISREG(info.st_mode))
+        {
+            return false;
+        }
+
+        size = static_cast<uint64_t>(info.st_size);
+        modified = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 +
+                   info.st_mtim.tv_nsec;
+        return true;
+    }
+
+    bool operator==(const FileStamp &) const = default;
+};
+
+/// The header of a compiled file. See the documentation of CompiledOutput.ipp.
+struct CompiledHeader
+{
+    char magic[8];         ///< CompiledMagic.
+    uint32_t valueSize;    ///< The size of a value, i.e., sizeof(T).
+    uint32_t valueDigits;  ///< The digits of a value in numeric_limits<T>.
+    char rawDigest[32];    ///< The raw digest of <correct_output_file>.
+    FileStamp rawStamp;    ///< The stamp of <correct_output_file>.
+    uint64_t tokenCount;   ///< The number of tokens, excluding the end.
+    uint64_t valueCount;   ///< The number of Valid tokens.
+    uint64_t lineCount;    ///< The number of Newline tokens.
+    uint64_t kindsOffset;  ///< The offset of the kinds section.
+    uint64_t valuesOffset; ///< The offset of the values section.
+    uint64_t linesOffset;  ///< The offset of the lines section.
+};
+
+/// The start of a line in a compiled file.
+struct CompiledLine
+{
+    uint64_t token; ///< The index of the first token of the line.
+    uint64_t value; ///< The index of the first value of the line.
+};
+
+/// The magic bytes of a compiled file, which change with its layout.
+constexpr char CompiledMagic[8] = {'V', 'P', 'L', 'C', 'T', 'O', 'K', '2'};
+
+/// The alignment of the sections of a compiled file.
+constexpr uint64_t CompiledAlignment = 16;
+
+/// Rounds an offset in a compiled file up to CompiledAlignment.
+constexpr uint64_t alignCompiled(uint64_t offset)
+{
+    return (offset + CompiledAlignment - 1) / CompiledAlignment * CompiledAlignment;
+}
+
+/// The number of bytes that hold the value of a T, which are fewer than
+/// sizeof(T) for the x87 extended precision long double, whose last bytes are
+/// padding.
+template<typename T>
+constexpr size_t compiledValueBytes()
+{
+    if constexpr (std::numeric_limits<T>::digits == 64 &&
+                  std::numeric_limits<T>::max_exponent == 16384)
+    {
+        return std::min<size_t>(10, sizeof(T));
+    }
+    else
+    {
+        return sizeof(T);
+    }
+}
+
+/// A memory-mapped compiled file, whose values have the type T.
+template<typename T>
+class CompiledOutput
+{
+    private:
+        MappedFile mMapping;     ///< The mapping of the file.
+        CompiledHeader mHeader;  ///< The header of the file.
+        const uint8_t *mKinds;   ///< The kinds section.
+        const T *mValues;        ///< The values section.
+        const CompiledLine *mLines; ///< The lines section.
+
+        /// Checks whether a section of a given size fits in the file.
+        bool fits(uint64_t offset, uint64_t count, uint64_t size) const
+        {
+            uint64_t fileSize = static_cast<uint64_t>(mMapping.end() - mMapping.begin());
+
+            return offset % CompiledAlignment == 0 && offset <= fileSize &&
+                   count <= (fileSize - offset) / size;
+        }
+
+    public:
+        CompiledOutput() :
+              mMapping(), mHeader(), mKinds(nullptr), mValues(nullptr),
+              mLines(nullptr)
+        {
+        }
+
+        CompiledOutput(const CompiledOutput &) = delete;
+        CompiledOutput & operator=(const CompiledOutput &) = delete;
+
+        /// Maps and validates the compiled file at a given path.
+        /// @param path The path of the compiled file.
+        /// @return Whether the file is a valid compiled file for T.
+        bool load(const char *path)
+        {
+            if (!mMapping.map(path) ||
+                static_cast<size_t>(mMapping.end() - mMapping.begin()) < sizeof(mHeader))
+            {
+                return false;
+            }
+
+            std::memcpy(&mHeader, mMapping.begin(), sizeof(mHeader));
+
+            if (std::memcmp(mHeader.magic, CompiledMagic, sizeof(CompiledMagic)) != 0 ||
+                mHeader.valueSize != sizeof(T) ||
+                mHeader.valueDigits != static_cast<uint32_t>(std::numeric_limits<T>::digits) ||
+                !fits(mHeader.kindsOffset, mHeader.tokenCount, 1) ||
+                !fits(mHeader.valuesOffset, mHeader.valueCount, sizeof(T)) ||
+                !fits(mHeader.linesOffset, mHeader.lineCount, sizeof(CompiledLine)))
+            {
+                return false;
+            }
+
+            mKinds = reinterpret_cast<const uint8_t *>(mMapping.begin() + mHeader.kindsOffset);
+            mValues = reinterpret_cast<const T *>(mMapping.begin() + mHeader.valuesOffset);
+            mLines = reinterpret_cast<const CompiledLine *>(mMapping.begin() + mHeader.linesOffset);
+
+            // The sections are not scanned here. CompiledTokenizer checks the
+            // indices that it reads them by instead.
+            return true;
+        }
+
+        /// Checks whether the file was compiled from the file at a given path,
+        /// as it is now, by its stamp, without reading it.
+        bool isCompiledFrom(const char *path) const
+        {
+            FileStamp stamp;
+
+            return stamp.read(path) && stamp == mHeader.rawStamp;
+        }
+
+        /// The header of the file.
+        const CompiledHeader & header() const
+        {
+            return mHeader;
+        }
+
+        /// The raw digest of the bytes that the file was compiled from.
+        string rawDigest() const
+        {
+            return string(mHeader.rawDigest, sizeof(mHeader.rawDigest));
+        }
+
+        /// The kinds section.
+        const uint8_t * kinds() const
+        {
+            return mKinds;
+        }
+
+        /// The values section.
+        const T * values() const
+        {
+            return mValues;
+        }
+
+        /// The lines section.
+        const CompiledLine * lines() const
+        {
+            return mLines;
+        }
+};
+
+/// A class to read the tokens of a CompiledOutput, with the interface of the
+/// Tokenizer it was compiled with, as far as diff_checker_base.ipp uses it.
+/// The bytes that the file was compiled from are skipped alongside, so that
+/// the caller can scan them as it would with the Tokenizer.
+/// @tparam Tokenizer The tokenizer with which the file was compiled.
+template<typename Tokenizer>
+class CompiledTokenizer
+{
+    public:
+        /// The value type of the Token objects produced.
+        typedef typename Tokenizer::ValueType ValueType;
+        /// The Token type instantiated in this class.
+        typedef typename Tokenizer::TokenType TokenType;
+        /// The Token::Kind type instantiated in this class.
+        typedef typename Tokenizer::TokenKind TokenKind;
+        /// The Token::Pos type instantiated in this class.
+        typedef typename Tokenizer::TokenPos TokenPos;
+
+    private:
+        const CompiledOutput<ValueType> & mOutput; ///< The compiled file.
+        typename Tokenizer::InputType & mInput;    ///< The compiled bytes.
+        uint64_t mIndex;    ///< The index of the next token.
+        uint64_t mValue;    ///< The index of the next value.
+        TokenPos mLine;     ///< The line number for the next token.
+        TokenPos mToken;    ///< The token number for the next token.
+        TokenPos mColumn;   ///< The column for the next valid token.
+
+    public:
+        /// Constructs a tokenizer on a compiled file.
+        /// @param output The compiled file, which must outlive the tokenizer.
+        /// @param input The input backend of the bytes that the file was
+        ///              compiled from.
+        CompiledTokenizer(const CompiledOutput<ValueType> &output,
+                          typename Tokenizer::InputType &input) :
+              mOutput(output), mInput(input), mIndex(0), mValue(0), mLine(1),
+              mToken(1), mColumn(0)
+        {
+        }
+
+        /// Skips complete lines, as BasicTokenizer::skipLines() does.
+        /// @param count The number of bytes to skip in the input backend.
+        /// @param lines The number of newlines within the skipped bytes.
+        void skipLines(size_t count, TokenPos lines)
+        {
+            if (mToken != 1)
+            {
+                throw logic_error("Cannot skip lines from the middle of a line.");
+            }
+
+            TokenPos line = mLine + lines;
+
+            if (line - 1 > mOutput.header().lineCount)
+            {
+                throw logic_error("Cannot skip lines past the end.");
+            }
+
+            if (line > 1)
+            {
+                mIndex = mOutput.lines()[line - 2].token;
+                mValue = mOutput.lines()[line - 2].value;
+            }
+
+            mInput.skip(count);
+            mLine = line;
+        }
+
+        /// Produces the next token. The indices into the sections are checked,
+        /// so that a corrupt file yields an invalid token rather than a read
+        /// out of the sections.
+        TokenType next()
+        {
+            if (mIndex >= mOutput.header().tokenCount)
+            {
+                return TokenType(TokenKind::EndOfFile, mLine, mToken);
+            }
+
+            switch (mOutput.kinds()[mIndex++])
+            {
+                case TokenKind::Valid:
+                    if (mValue >= mOutput.header().valueCount)
+                    {
+                        return TokenType(TokenKind::Invalid, mLine, mToken);
+                    }
+
+                    return TokenType(mOutput.values()[mValue++], mLine, mToken++,
+                                     mColumn++);
+                case TokenKind::Space:
+                    return TokenType(TokenKind::Space, mLine, mToken++);
+                case TokenKind::Newline:
+                {
+                    TokenType t(TokenKind::Newline, mLine, mToken);
+                    mLine++;
+                    mToken = 1;
+                    mColumn = 0;
+                    return t;
+                }
+                default:
+                    return TokenType(TokenKind::Invalid, mLine, mToken);
+            }
+        }
+};
+
+/// Compiles the tokens of a tokenizer into a compiled file. See the
+/// documentation of CompiledOutput.ipp.
+/// @param tokenizer The tokenizer, which is read until its end.
+/// @param rawDigest The raw digest of the bytes that the tokenizer reads.
+/// @param rawStamp The stamp of the file that the tokenizer reads, taken
+///                 before it is read.
+/// @param path The path of the compiled file to write.
+/// @return 1 if the file was written, 0 if a token was invalid, and -1 if the
+///         file could not be written.
+template<typename Tokenizer>
+int writeCompiledFile(Tokenizer &tokenizer, const string &rawDigest,
+                      const FileStamp &rawStamp, const string &path)
+{
+    typedef typename Tokenizer::ValueType T;
+
+    vector<uint8_t> kinds;
+    vector<char> values; // The bytes of the values, with zeroed padding.
+    uint64_t valueCount = 0;
+    vector<CompiledLine> lines;
+
+    while (true)
+    {
+        auto token = tokenizer.next();
+
+        if (token.kind() == Tokenizer::TokenKind::EndOfFile)
+        {
+            break;
+        }
+        else if (token.kind() == Tokenizer::TokenKind::Invalid)
+        {
+            return 0;
+        }
+
+        kinds.push_back(static_cast<uint8_t>(token.kind()));
+
+        if (token.kind() == Tokenizer::TokenKind::Valid)
+        {
+            values.resize(values.size() + sizeof(T));
+            std::memcpy(values.data() + values.size() - sizeof(T), &token.value(),
+                        compiledValueBytes<T>());
+            valueCount++;
+        }
+        else if (token.kind() == Tokenizer::TokenKind::Newline)
+        {
+            lines.push_back({kinds.size(), valueCount});
+        }
+    }
+
+    CompiledHeader header = {};
+
+    std::memcpy(header.magic, CompiledMagic, sizeof(CompiledMagic));
+    header.valueSize = sizeof(T);
+    header.valueDigits = std::numeric_limits<T>::digits;
+
+    if (rawDigest.size() != sizeof(header.rawDigest))
+    {
+        throw logic_error("Invalid raw digest.");
+    }
+
+    std::memcpy(header.rawDigest, rawDigest.data(), rawDigest.size());
+    header.rawStamp = rawStamp;
+    header.tokenCount = kinds.size();
+    header.valueCount = valueCount;
+    header.lineCount = lines.size();
+    header.kindsOffset = alignCompiled(sizeof(header));
+    header.valuesOffset = alignCompiled(header.kindsOffset + kinds.size());
+    header.linesOffset = alignCompiled(header.valuesOffset + values.size());
+
+    ofstream file(path, std::ios::binary);
+    uint64_t offset = 0;
+
+    auto write = [&](uint64_t at, const void *data, uint64_t size)
+    {
+        static const char padding[CompiledAlignment] = {};
+
+        file.write(padding, static_cast<std::streamsize>(at - offset));
+        file.write(static_cast<const char *>(data), static_cast<std::streamsize>(size));
+        offset = at + size;
+    };
+
+    write(0, &header, sizeof(header));
+    write(header.kindsOffset, kinds.data(), kinds.size());
+    write(header.valuesOffset, values.data(), values.size());
+    write(header.linesOffset, lines.data(), lines.size() * sizeof(CompiledLine));
+
+    return file.flush() ? 1 : -1;
+}
@@ -0,0 +1,246 @@
+// Author: Hakan Yıldız
+// Shared under MIT License. See the file LICENSE for more info.
+
+/// @file Digest.ipp
+/// Implements the digests with which a checker accepts a claimed output without
+/// comparing its tokens to <correct_output_file> (see diff_checker_base.ipp).
+/// The canonical digest of a file is the hash of its token stream, as read by
+/// a Tokenizer, in which equal tokens have equal encodings. Hence, if two files
+/// have the same canonical digest, their tokens are identical (barring a hash
+/// collision), which makes them equal under any equal policy.
+///
+/// The digest file of <correct_output_file> is written by diff_digest.cpp next
+/// to it, with a suffix that names the tokenizer. It has a single line:
+///     <canonical_digest> <raw_digest>
+/// where <raw_digest> is the hash of the bytes of <correct_output_file>, so that
+/// a digest file is ignored once <correct_output_file> changes.
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <type_traits>
+
+#include "Integer.ipp"
+
+using std::ifstream;
+using std::size_t;
+using std::string;
+using std::uint64_t;
+
+/// The suffix of the digest files for CharTokenizer.
+constexpr const char *CharDigestSuffix = ".char.digest";
+
+/// The suffix of the digest files for RealTokenizer.
+constexpr const char *RealDigestSuffix = ".real.digest";
+
+/// A streaming, non-cryptographic 128-bit hash, in the style of xxHash64 with
+/// two lanes.
+class Digest
+{
+    private:
+        static constexpr uint64_t Prime1 = 0x9E3779B185EBCA87ULL; ///< A mixing constant.
+        static constexpr uint64_t Prime2 = 0xC2B2AE3D27D4EB4FULL; ///< A mixing constant.
+
+        uint64_t mLanes[2]; ///< The state of the lanes.
+        uint64_t mWord;     ///< The bytes of the incomplete word.
+        unsigned mWordSize; ///< The number of bytes in mWord.
+        uint64_t mLength;   ///< The number of bytes so far.
+
+        /// Rotates the bits of a word to the left.
+        static uint64_t rotate(uint64_t word, int bits)
+        {
+            return (word << bits) | (word >> (64 - bits));
+        }
+
+        /// Mixes the bits of a word thoroughly.
+        static uint64_t avalanche(uint64_t word)
+        {
+            word ^= word >> 33;
+            word *= Prime2;
+            word ^= word >> 29;
+            word *= Prime1;
+            word ^= word >> 32;
+            return word;
+        }
+
+        /// Mixes a complete word into the lanes.
+        void mix(uint64_t word)
+        {
+            mLanes[0] = rotate(mLanes[0] + word * Prime2, 31) * Prime1;
+            mLanes[1] = rotate(mLanes[1] + rotate(word, 29) * Prime1, 27) * Prime2;
+        }
+
+    public:
+        Digest() :
+              mLanes{Prime1 + Prime2, Prime2 - Prime1}, mWord(0), mWordSize(0),
+              mLength(0)
+        {
+        }
+
+        /// Appends bytes.
+        /// @param data The first byte.
+        /// @param count The number of bytes.
+        void append(const char *data, size_t count)
+        {
+            mLength += count;
+
+            for (; count > 0 && mWordSize > 0; data++, count--)
+            {
+                mWord |= uint64_t(static_cast<unsigned char>(*data)) << (8 * mWordSize);
+
+                if (++mWordSize == 8)
+                {
+                    mix(mWord);
+                    mWord = 0;
+                    mWordSize = 0;
+                }
+            }
+
+            for (; count >= 8; data += 8, count -= 8)
+            {
+                uint64_t word;
+                std::memcpy(&word, data, 8);
+                mix(word);
+            }
+
+            for (; count > 0; data++, count--)
+            {
+                mWord |= uint64_t(static_cast<unsigned char>(*data)) << (8 * mWordSize);
+                mWordSize++;
+            }
+        }
+
+        /// Returns the hash of the bytes so far, as 32 hexadecimal digits.
+        string hex() const
+        {
+            Digest final = *this;
+
+            final.mix(final.mWord ^ (uint64_t(final.mWordSize) << 56));
+
+            uint64_t words[2] = {avalanche(final.mLanes[0] ^ final.mLength),
+                                 avalanche(final.mLanes[1] + final.mLength * Prime1)};
+            string result;
+
+            for (uint64_t word : words)
+            {
+                for (int shift = 60; shift >= 0; shift -= 4)
+                {
+                    result += "0123456789abcdef"[(word >> shift) & 0xF];
+                }
+            }
+
+            return result;
+        }
+};
+
+/// Appends the canonical encoding of the value of a token to a digest, such
+/// that equal values have equal encodings, and the encodings are prefix-free.
+template<typename T>
+void appendCanonical(Digest &digest, const T &value)
+{
+    if constexpr (std::is_same_v<T, char>)
+    {
+        digest.append("c", 1);
+        digest.append(&value, 1);
+    }
+    else if constexpr (std::is_floating_point_v<T>)
+    {
+        static_assert(std::numeric_limits<T>::digits <= 64);
+
+        // Zeros of either sign are equal. Others are encoded by their sign,
+        // significand and exponent, which are exact.
+        if (value == 0)
+        {
+            digest.append("0", 1);
+            return;
+        }
+
+        int exponent;
+        T fraction = std::frexp(value, &exponent);
+        uint64_t significand = static_cast<uint64_t>(
+            std::ldexp(fraction < 0 ? -fraction : fraction,
+                       std::numeric_limits<T>::digits));
+        std::int32_t exponent32 = exponent;
+
+        digest.append(fraction < 0 ? "-" : "+", 1);
+        digest.append(reinterpret_cast<const char *>(&significand), sizeof(significand));
+        digest.append(reinterpret_cast<const char *>(&exponent32), sizeof(exponent32));
+    }
+    else if constexpr (std::is_integral_v<T>)
+    {
+        std::int64_t integer = value;
+
+        digest.append("i", 1);
+        digest.append(reinterpret_cast<const char *>(&integer), sizeof(integer));
+    }
+    else if constexpr (std::is_same_v<T, Integer>)
+    {
+        // Each integer has a single decimal form, e.g., without leading zeros.
+        string text;
+
+        value.appendTo(text);
+
+        uint64_t length = text.size();
+
+        digest.append("n", 1);
+        digest.append(reinterpret_cast<const char *>(&length), sizeof(length));
+        digest.append(text.data(), text.size());
+    }
+    else
+    {
+        uint64_t length = value.size();
+
+        digest.append("s", 1);
+        digest.append(reinterpret_cast<const char *>(&length), sizeof(length));
+        digest.append(value.data(), value.size());
+    }
+}
+
+/// Computes the canonical digest of the tokens of a tokenizer.
+/// @param tokenizer The tokenizer, which is read until its end.
+/// @param digest The digest to append to.
+/// @return Whether all the tokens were valid.
+template<typename Tokenizer>
+bool appendCanonicalTokens(Tokenizer &tokenizer, Digest &digest)
+{
+    while (true)
+    {
+        auto token = tokenizer.next();
+
+        switch (token.kind())
+        {
+            case Tokenizer::TokenKind::Valid:
+                appendCanonical(digest, token.value());
+                break;
+            case Tokenizer::TokenKind::Space:
+                digest.append(" ", 1);
+                break;
+            case Tokenizer::TokenKind::Newline:
+                digest.append("\n", 1);
+                break;
+            case Tokenizer::TokenKind::EndOfFile:
+                return true;
+            default:
+                return false;
+        }
+    }
+}
+
+/// Reads a digest file. See the documentation of Digest.ipp.
+/// @param path The path of the digest file.
+/// @param canonical Set to the canonical digest.
+/// @param raw Set to the raw digest.
+/// @return Whether the file could be read.
+inline bool readDigestFile(const string &path, string &canonical, string &raw)
+{
+    ifstream file(path);
+
+    return static_cast<bool>(file >> canonical >> raw) &&
+           canonical.size() == 32 && raw.size() == 32;
+}
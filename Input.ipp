@@ -0,0 +1,878 @@
+// Author: Hakan Yıldız
+// Shared under MIT License. See the file LICENSE for more info.
+
+/// @file Input.ipp
+/// Implements the input backends from which a Tokenizer reads its characters:
+/// - StreamInput reads through an std::istream.
+/// - ByteInput scans raw bytes through a pointer. The bytes are read in the
+///   fastest way for the type of the file:
+///   - A regular file is mapped to memory, with sequential readahead.
+///   - A regular file on a network file system is read as a whole with large
+///     reads into a page-aligned buffer, after advising sequential readahead,
+///     as its mapping would fault on each page over the network.
+///   - A pipe or a socket is read on a helper thread into one buffer while the
+///     bytes of the other are scanned (see PipeReader), so that its bytes are
+///     scanned as soon as they arrive.
+///   - Other files (e.g., terminals) are read in chunks as a fallback.
+/// Both backends provide the same interface (see StreamInput), so that the
+/// backend of a Tokenizer can be picked at compile time. ByteInput reads values
+/// with the parse policy of the Tokenizer (see Parse.ipp).
+
+#pragma once
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "CheckerStats.ipp"
+
+using std::ifstream;
+using std::istream;
+using std::size_t;
+using std::unique_ptr;
+using std::vector;
+
+/// Checks whether a character is whitespace, as in the "C" locale.
+inline bool isSpaceChar(int c)
+{
+    return c == ' ' || ('\t' <= c && c <= '\r');
+}
+
+/// An input backend that reads through an std::istream.
+class StreamInput
+{
+    private:
+        unique_ptr<ifstream> mOwnedStream; ///< The stream opened from a path.
+        istream & mInput;                  ///< The stream to read from.
+
+    public:
+        /// Constructs the backend on a given istream.
+        StreamInput(istream & input) :
+              mOwnedStream(), mInput(input)
+        {
+        }
+
+        /// Constructs the backend by opening the file at a given path.
+        StreamInput(const char *path) :
+              mOwnedStream(new ifstream(path)), mInput(*mOwnedStream)
+        {
+        }
+
+        StreamInput(const StreamInput &) = delete;
+        StreamInput & operator=(const StreamInput &) = delete;
+
+        /// Whether opening the input failed.
+        bool fail() const
+        {
+            return mInput.fail();
+        }
+
+        /// Returns the next character without consuming it, or EOF.
+        int peek()
+        {
+            return mInput.peek();
+        }
+
+        /// Consumes and returns the next character, or EOF.
+        int get()
+        {
+            return mInput.get();
+        }
+
+        /// Reads a value with operator>>, skipping leading whitespace. The parse
+        /// policy is ignored.
+        /// @param value The value to read into.
+        /// @return Whether the value could be read.
+        template<typename T, typename Parse>
+        bool extract(T &value, Parse &)
+        {
+            mInput >> value;
+            return !mInput.fail();
+        }
+};
+
+/// A read-only memory mapping of a regular file.
+class MappedFile
+{
+    private:
+        void *mData;  ///< The start of the mapping, or nullptr if none.
+        size_t mSize; ///< The size of the mapping.
+
+    public:
+        /// Constructs an empty mapping.
+        MappedFile() :
+              mData(nullptr), mSize(0)
+        {
+        }
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile & operator=(const MappedFile &) = delete;
+
+        ~MappedFile()
+        {
+            if (mData != nullptr)
+            {
+                munmap(mData, mSize);
+            }
+        }
+
+        /// Maps the file at a given path.
+        /// @return Whether the file is a regular file and could be mapped.
+        bool map(const char *path)
+        {
+            int fd = open(path, O_RDONLY);
+
+            if (fd < 0)
+            {
+                return false;
+            }
+
+            bool mapped = map(fd);
+
+            close(fd);
+            return mapped;
+        }
+
+        /// Maps the file of an open descriptor, which stays open.
+        /// @return Whether the file is a regular file and could be mapped.
+        bool map(int fd)
+        {
+            struct stat info;
+
+            if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode))
+            {
+                return false;
+            }
+
+            mSize = static_cast<size_t>(info.st_size);
+
+            if (mSize > 0)
+            {
+                void *data = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+
+                if (data == MAP_FAILED)
+                {
+                    mSize = 0;
+                    return false;
+                }
+
+                madvise(data, mSize, MADV_SEQUENTIAL);
+                mData = data;
+            }
+
+            return true;
+        }
+
+        /// The first byte of the mapping.
+        const char * begin() const
+        {
+            return static_cast<const char *>(mData);
+        }
+
+        /// One past the last byte of the mapping.
+        const char * end() const
+        {
+            return begin() + mSize;
+        }
+};
+
+/// Checks whether the file of an open descriptor is on a network (or a FUSE)
+/// file system, whose pages are slow to fault in one by one.
+inline bool isNetworkFile(int fd)
+{
+    struct statfs info;
+
+    if (fstatfs(fd, &info) != 0)
+    {
+        return false;
+    }
+
+    switch (static_cast<unsigned long>(info.f_type))
+    {
+        case 0x6969:     // NFS
+        case 0x517B:     // SMB
+        case 0xFF534D42: // CIFS
+        case 0xFE534D42: // SMB2
+        case 0x00C36400: // Ceph
+        case 0x01021997: // 9P
+        case 0x5346414F: // AFS
+        case 0x65735546: // FUSE
+            return true;
+        default:
+            return false;
+    }
+}
+
+/// A buffer of bytes that starts at a page boundary, which the kernel copies to
+/// faster.
+class AlignedBuffer
+{
+    private:
+        static constexpr size_t Alignment = 4096; ///< The alignment of the bytes.
+
+        /// Frees the bytes of the buffer.
+        struct Free
+        {
+            void operator()(char *data) const
+            {
+                std::free(data);
+            }
+        };
+
+        unique_ptr<char, Free> mData; ///< The bytes, or nullptr if none.
+        size_t mSize;                 ///< The number of bytes.
+
+    public:
+        /// Constructs an empty buffer.
+        AlignedBuffer() :
+              mData(), mSize(0)
+        {
+        }
+
+        /// Resizes the buffer, keeping its bytes up to the new size.
+        /// @return Whether the bytes could be allocated.
+        bool resize(size_t size)
+        {
+            void *data = nullptr;
+
+            if (posix_memalign(&data, Alignment, std::max<size_t>(size, 1)) != 0)
+            {
+                return false;
+            }
+
+            if (mData)
+            {
+                std::memcpy(data, mData.get(), std::min(size, mSize));
+            }
+
+            mData.reset(static_cast<char *>(data));
+            mSize = size;
+            return true;
+        }
+
+        /// The first byte.
+        char * data() const
+        {
+            return mData.get();
+        }
+
+        /// The number of bytes.
+        size_t size() const
+        {
+            return mSize;
+        }
+};
+
+/// Reads a pipe (or a socket) on a helper thread, so that the system calls and
+/// the waits for the writer overlap with the scanning of the bytes read so far.
+/// The thread reads into a back buffer, which take() moves to the reader while
+/// the thread reads into another one. The descriptor must be non-blocking.
+class PipeReader
+{
+    private:
+        int mFd;                          ///< The descriptor to read, which stays open.
+        int mWake[2];                     ///< A pipe that wakes the thread to stop it.
+        vector<char> mBack;               ///< The back buffer, owned by the thread if not full.
+        size_t mBackSize;                 ///< The number of bytes in the back buffer.
+        bool mIsFull;                     ///< Whether the back buffer awaits take().
+        bool mIsEnded;                    ///< Whether the input ended, or failed.
+        bool mIsStopping;                 ///< Whether the thread is to stop.
+        std::mutex mMutex;                ///< Guards the flags.
+        std::condition_variable mChanged; ///< Notified as a flag changes.
+        std::thread mThread;              ///< The helper thread.
+
+        /// Implements the helper thread, which reads until the input ends or the
+        /// reader is destroyed.
+        void run()
+        {
+            while (true)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(mMutex);
+
+                    mChanged.wait(lock, [this] { return !mIsFull || mIsStopping; });
+
+                    if (mIsStopping)
+                    {
+                        return;
+                    }
+                }
+
+                ssize_t count = read(mFd, mBack.data(), mBack.size());
+
+                if (count < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                else if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                {
+                    // Wait for the bytes without blocking in read(), so that the
+                    // destructor can wake the thread up. A read comes first, as
+                    // poll() reports no end for a FIFO that had no writer when it
+                    // was opened, until a writer comes.
+                    pollfd ready[2] = {{mFd, POLLIN, 0}, {mWake[0], POLLIN, 0}};
+
+                    poll(ready, 2, -1);
+
+                    if (ready[1].revents != 0)
+                    {
+                        return;
+                    }
+
+                    continue;
+                }
+
+                {
+                    std::lock_guard<std::mutex> lock(mMutex);
+
+                    if (count > 0)
+                    {
+                        mBackSize = static_cast<size_t>(count);
+                        mIsFull = true;
+                    }
+                    else
+                    {
+                        mIsEnded = true;
+                    }
+                }
+
+                mChanged.notify_all();
+
+                if (count <= 0)
+                {
+                    return;
+                }
+            }
+        }
+
+    public:
+        /// Constructs the reader of an open descriptor, without starting it.
+        /// @param fd        The descriptor, which must outlive the reader.
+        /// @param chunkSize The size of each read.
+        PipeReader(int fd, size_t chunkSize) :
+              mFd(fd), mWake{-1, -1}, mBack(chunkSize), mBackSize(0), mIsFull(false),
+              mIsEnded(false), mIsStopping(false), mMutex(), mChanged(), mThread()
+        {
+        }
+
+        PipeReader(const PipeReader &) = delete;
+        PipeReader & operator=(const PipeReader &) = delete;
+
+        ~PipeReader()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mIsStopping = true;
+            }
+
+            mChanged.notify_all();
+
+            if (mThread.joinable())
+            {
+                char c = 0;
+
+                while (write(mWake[1], &c, 1) < 0 && errno == EINTR)
+                {
+                }
+
+                mThread.join();
+            }
+
+            for (int fd : mWake)
+            {
+                if (fd >= 0)
+                {
+                    close(fd);
+                }
+            }
+        }
+
+        /// Starts the helper thread.
+        /// @return Whether the thread could be started.
+        bool start()
+        {
+            if (pipe(mWake) != 0)
+            {
+                mWake[0] = mWake[1] = -1;
+                return false;
+            }
+
+            try
+            {
+                mThread = std::thread(&PipeReader::run, this);
+            }
+            catch (const std::system_error &)
+            {
+                return false;
+            }
+
+            return true;
+        }
+
+        /// Moves the bytes that the helper thread has read into a buffer. If no
+        /// bytes are to be waited for, the bytes are moved only if they have
+        /// arrived already.
+        /// @param buffer The buffer, whose bytes up to offset are kept. It is
+        ///               swapped with the back buffer if offset is 0.
+        /// @param offset The position in the buffer to move the bytes to.
+        /// @param wait   Whether to wait for the bytes.
+        /// @param isCut  Set to true if no bytes are moved while more could still
+        ///               arrive.
+        /// @return The number of bytes moved, or 0 if the input ended.
+        size_t take(vector<char> &buffer, size_t offset, bool wait, bool &isCut)
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+
+            if (!wait && !mIsFull && !mIsEnded)
+            {
+                lock.unlock();
+
+                pollfd ready = {mFd, POLLIN, 0};
+
+                if (poll(&ready, 1, 0) <= 0)
+                {
+                    ready.revents = 0;
+                }
+
+                lock.lock();
+
+                if (!mIsFull && !mIsEnded && ready.revents == 0)
+                {
+                    isCut = true;
+                    return 0;
+                }
+            }
+
+            mChanged.wait(lock, [this] { return mIsFull || mIsEnded; });
+
+            if (!mIsFull)
+            {
+                return 0;
+            }
+
+            size_t count = mBackSize;
+
+            if (offset == 0)
+            {
+                buffer.swap(mBack);
+
+                if (mBack.size() < buffer.size())
+                {
+                    mBack.resize(buffer.size());
+                }
+            }
+            else
+            {
+                if (buffer.size() < offset + count)
+                {
+                    buffer.resize(offset + count);
+                }
+
+                std::memcpy(buffer.data() + offset, mBack.data(), count);
+            }
+
+            mIsFull = false;
+            lock.unlock();
+            mChanged.notify_all();
+            return count;
+        }
+};
+
+/// An input backend that scans raw bytes through a pointer. The bytes come
+/// from the fastest source for the type of the file (see Input.ipp), and are
+/// scanned the same way. A read returns the bytes of a pipe that have arrived
+/// so far, so that a mismatch is found while its writer is still running.
+class ByteInput
+{
+    private:
+        static constexpr size_t ChunkSize = 1 << 16; ///< Fallback read size.
+
+        /// The size of each read of a file on a network file system.
+        static constexpr size_t LargeReadSize = 1 << 22;
+
+        MappedFile mMapping;            ///< The mapping of the file, if any.
+        AlignedBuffer mWhole;           ///< The whole file on a network file system.
+        int mFd;                        ///< The fallback descriptor, or -1 if none.
+        unique_ptr<PipeReader> mReader; ///< The reader of mFd, if a pipe.
+        vector<char> mBuffer;           ///< The buffer for the fallback reads.
+        const char *mPos;               ///< The next byte to scan.
+        const char *mEnd;               ///< One past the last available byte.
+        bool mFailed;                   ///< The underlying field for fail().
+        bool mWaits;                    ///< Whether reads wait for more bytes.
+        bool mCut;                      ///< The underlying field for isCut().
+
+        /// Reads more bytes from the fallback descriptor into the window,
+        /// keeping the unscanned bytes. A read error ends the input.
+        /// @return Whether new bytes became available.
+        bool fill()
+        {
+            if (mFd < 0)
+            {
+                return false;
+            }
+
+            if (mReader)
+            {
+                size_t kept = static_cast<size_t>(mEnd - mPos);
+
+                if (kept > 0 && mPos != mBuffer.data())
+                {
+                    std::memmove(mBuffer.data(), mPos, kept);
+                }
+
+                size_t count = mReader->take(mBuffer, kept, mWaits, mCut);
+
+                mPos = mBuffer.data();
+                mEnd = mPos + kept + count;
+                countRead(count);
+                return count > 0;
+            }
+
+            if (!mWaits)
+            {
+                pollfd ready = {mFd, POLLIN, 0};
+
+                if (poll(&ready, 1, 0) <= 0 || (ready.revents & POLLIN) == 0)
+                {
+                    mCut = mCut || ready.revents == 0;
+                    return false;
+                }
+            }
+
+            size_t kept = static_cast<size_t>(mEnd - mPos);
+
+            if (kept > 0 && mPos != mBuffer.data())
+            {
+                std::memmove(mBuffer.data(), mPos, kept);
+            }
+
+            if (mBuffer.size() - kept < ChunkSize)
+            {
+                mBuffer.resize(kept + ChunkSize);
+            }
+
+            ssize_t count;
+
+            do
+            {
+                count = read(mFd, mBuffer.data() + kept, mBuffer.size() - kept);
+            }
+            while (count < 0 && errno == EINTR);
+
+            if (count < 0)
+            {
+                count = 0;
+            }
+
+            mPos = mBuffer.data();
+            mEnd = mPos + kept + count;
+            countRead(static_cast<size_t>(count));
+            return count > 0;
+        }
+
+        /// Adds a read into mBuffer to the counters.
+        void countRead(size_t count)
+        {
+            if constexpr (CheckerStatsEnabled)
+            {
+                checkerStats.bytesRead += count;
+                checkerStats.raisePeakBuffer(mBuffer.size());
+            }
+        }
+
+        /// Reads the whole file of a descriptor into mWhole, with large reads.
+        /// @return Whether the file could be read.
+        bool readWhole(int fd)
+        {
+            struct stat info;
+
+            if (fstat(fd, &info) != 0)
+            {
+                return false;
+            }
+
+            posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+            posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+
+            // One more byte than the size, so that a file that grew is noticed.
+            size_t size = 0;
+
+            if (!mWhole.resize(static_cast<size_t>(info.st_size) + 1))
+            {
+                return false;
+            }
+
+            while (true)
+            {
+                if (size == mWhole.size() && !mWhole.resize(2 * size))
+                {
+                    return false;
+                }
+
+                ssize_t count = read(fd, mWhole.data() + size,
+                                     std::min(LargeReadSize, mWhole.size() - size));
+
+                if (count < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                else if (count < 0)
+                {
+                    return false;
+                }
+                else if (count == 0)
+                {
+                    break;
+                }
+
+                size += static_cast<size_t>(count);
+            }
+
+            mPos = mWhole.data();
+            mEnd = mPos + size;
+
+            if constexpr (CheckerStatsEnabled)
+            {
+                checkerStats.bytesRead += size;
+                checkerStats.raisePeakBuffer(mWhole.size());
+            }
+
+            return true;
+        }
+
+        /// Makes sure the window extends past the whitespace-delimited word at
+        /// the current position, unless the input ends before that.
+        void fillWord()
+        {
+            const char *p = mPos;
+
+            while (true)
+            {
+                while (p != mEnd && !isSpaceChar(static_cast<unsigned char>(*p)))
+                {
+                    p++;
+                }
+
+                size_t offset = static_cast<size_t>(p - mPos);
+
+                if (p != mEnd || !fill())
+                {
+                    return;
+                }
+
+                p = mPos + offset;
+            }
+        }
+
+    public:
+        /// Constructs the backend by opening the file at a given path. A FIFO
+        /// is opened without waiting for a writer, so it must have one already
+        /// (or be read as empty).
+        ByteInput(const char *path) :
+              mMapping(), mWhole(), mFd(-1), mReader(), mBuffer(), mPos(nullptr),
+              mEnd(nullptr), mFailed(false), mWaits(true), mCut(false)
+        {
+            int fd = open(path, O_RDONLY | O_NONBLOCK);
+            struct stat info;
+
+            if (fd < 0 || fstat(fd, &info) != 0)
+            {
+                mFailed = true;
+
+                if (fd >= 0)
+                {
+                    close(fd);
+                }
+            }
+            else if (S_ISREG(info.st_mode) && isNetworkFile(fd))
+            {
+                // A regular file never blocks, so O_NONBLOCK does not matter.
+                mFailed = !readWhole(fd);
+                close(fd);
+            }
+            else if (mMapping.map(fd))
+            {
+                mPos = mMapping.begin();
+                mEnd = mMapping.end();
+                close(fd);
+
+                if constexpr (CheckerStatsEnabled)
+                {
+                    checkerStats.bytesMapped += available();
+                }
+            }
+            else
+            {
+                mFd = fd;
+
+                if (S_ISFIFO(info.st_mode) || S_ISSOCK(info.st_mode))
+                {
+                    mReader.reset(new PipeReader(fd, ChunkSize));
+
+                    if (!mReader->start())
+                    {
+                        mReader.reset();
+                    }
+                }
+
+                // Otherwise, the reads block, as O_NONBLOCK is only for opening a
+                // FIFO.
+                if (!mReader)
+                {
+                    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+                }
+            }
+        }
+
+        /// Constructs the backend on a range of bytes, which must outlive it.
+        ByteInput(const char *begin, const char *end) :
+              mMapping(), mWhole(), mFd(-1), mReader(), mBuffer(), mPos(begin),
+              mEnd(end), mFailed(false), mWaits(true), mCut(false)
+        {
+        }
+
+        ByteInput(const ByteInput &) = delete;
+        ByteInput & operator=(const ByteInput &) = delete;
+
+        ~ByteInput()
+        {
+            // The helper thread must stop before its descriptor is closed.
+            mReader.reset();
+
+            if (mFd >= 0)
+            {
+                close(mFd);
+            }
+        }
+
+        /// Whether opening the input failed.
+        bool fail() const
+        {
+            return mFailed;
+        }
+
+        /// Whether all of the remaining bytes are in the window, i.e., the
+        /// input is not read through the fallback descriptor.
+        bool isContiguous() const
+        {
+            return mFd < 0;
+        }
+
+        /// Makes the input end where the bytes that have already arrived end,
+        /// rather than waiting for the writer of a pipe to write more or exit.
+        void stopWaiting()
+        {
+            mWaits = false;
+        }
+
+        /// Whether the input ended early due to stopWaiting(), i.e., while more
+        /// bytes could still arrive.
+        bool isCut() const
+        {
+            return mCut;
+        }
+
+        /// Reads the rest of the input into the window, so that available()
+        /// covers all of the remaining bytes, which stay in place until the
+        /// backend is destroyed.
+        void readToEnd()
+        {
+            while (fill())
+            {
+            }
+        }
+
+        /// The next byte to scan.
+        const char * position() const
+        {
+            return mPos;
+        }
+
+        /// The number of bytes available in the window from position().
+        size_t available() const
+        {
+            return static_cast<size_t>(mEnd - mPos);
+        }
+
+        /// Skips bytes in the window without scanning them.
+        /// @param count The number of bytes to skip. At most available().
+        void skip(size_t count)
+        {
+            mPos += count;
+        }
+
+        /// Returns the next character without consuming it, or EOF.
+        int peek()
+        {
+            if (mPos == mEnd && !fill())
+            {
+                return EOF;
+            }
+
+            return static_cast<unsigned char>(*mPos);
+        }
+
+        /// Consumes and returns the next character, or EOF.
+        int get()
+        {
+            int c = peek();
+
+            if (c != EOF)
+            {
+                mPos++;
+            }
+
+            return c;
+        }
+
+        /// Reads a value with a parse policy (see Parse.ipp), skipping leading
+        /// whitespace as operator>> does.
+        /// @param value The value to read into.
+        /// @param parse The parse policy.
+        /// @return Whether the value could be read.
+        template<typename T, typename Parse>
+        bool extract(T &value, Parse &parse)
+        {
+            int c = peek();
+
+            while (c != EOF && isSpaceChar(c))
+            {
+                mPos++;
+                c = peek();
+            }
+
+            if (c == EOF)
+            {
+                return false;
+            }
+
+            // The window of a contiguous input already extends to its end.
+            if constexpr (Parse::ReadsWord)
+            {
+                if (!isContiguous())
+                {
+                    fillWord();
+                }
+            }
+
+            return parse.parse(mPos, mEnd, value);
+        }
+};
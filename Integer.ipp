@@ -0,0 +1,111 @@
+// Author: Hakan Yıldız
+// Shared under MIT License. See the file LICENSE for more info.
+
+/// @file Integer.ipp
+/// Implements the Integer class, the value type of the tokens of
+/// diff_checker_int.cpp, which holds a decimal integer of any length.
+
+#pragma once
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+using std::int64_t;
+using std::ostream;
+using std::shared_ptr;
+using std::size_t;
+using std::string;
+using std::string_view;
+
+/// A decimal integer of any length. An integer that fits into int64_t is held
+/// as such, and a larger one as its digits, which are shared by the copies, so
+/// that the integers that occur in practice are compared and copied without
+/// touching the heap. Each integer has a single representation, so two integers
+/// are equal exactly if their values, or their digits, are equal.
+class Integer
+{
+    private:
+        /// The value, if the integer fits into int64_t, otherwise 1 if it is
+        /// negative and 0 if not.
+        int64_t mValue;
+        /// The digits of a larger magnitude, or nullptr.
+        shared_ptr<const string> mDigits;
+
+    public:
+        /// Constructs the integer 0.
+        Integer() :
+              mValue(0), mDigits()
+        {
+        }
+
+        /// Constructs an integer that fits into int64_t.
+        explicit Integer(int64_t value) :
+              mValue(value), mDigits()
+        {
+        }
+
+        /// Constructs an integer that does not fit into int64_t.
+        /// @param isNegative Whether the integer is negative.
+        /// @param digits     The digits of the magnitude, without leading zeros.
+        Integer(bool isNegative, string_view digits) :
+              mValue(isNegative), mDigits(std::make_shared<const string>(digits))
+        {
+        }
+
+        /// Whether the integer fits into int64_t, i.e., value() is valid.
+        bool isSmall() const
+        {
+            return mDigits == nullptr;
+        }
+
+        /// The value of the integer, if isSmall().
+        int64_t value() const
+        {
+            return mValue;
+        }
+
+        /// Checks whether two integers are equal.
+        friend bool operator==(const Integer &a, const Integer &b)
+        {
+            return a.mValue == b.mValue &&
+                   (a.mDigits == b.mDigits ||
+                    (a.mDigits != nullptr && b.mDigits != nullptr && *a.mDigits == *b.mDigits));
+        }
+
+        /// Appends the integer in decimal to a buffer, without allocating.
+        /// @param buffer The buffer to append to, e.g., std::string.
+        template<typename Buffer>
+        void appendTo(Buffer &buffer) const
+        {
+            if (isSmall())
+            {
+                char text[24];
+                auto result = std::to_chars(text, text + sizeof(text), mValue);
+
+                buffer.append(text, static_cast<size_t>(result.ptr - text));
+            }
+            else
+            {
+                if (mValue != 0)
+                {
+                    buffer.append("-", 1);
+                }
+
+                buffer.append(mDigits->data(), mDigits->size());
+            }
+        }
+
+        /// Writes the integer in decimal to a stream.
+        friend ostream & operator<<(ostream &output, const Integer &integer)
+        {
+            string text;
+
+            integer.appendTo(text);
+            return output << text;
+        }
+};
@@ -0,0 +1,425 @@
+// Author: Hakan Yıldız
+// Shared under MIT License. See the file LICENSE for more info.
+
+/// @file LineDiff.ipp
+/// Implements the line-level comparison of diff_checker_word.cpp: the WordLines
+/// class, which splits a text into lines of words without copying them, the
+/// LineInterner class, which numbers the distinct lines of two texts, and the
+/// longestCommonSubsequence function, which counts the lines that two texts
+/// have in common in linear memory.
+
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "Input.ipp"
+
+using std::size_t;
+using std::string_view;
+using std::uint32_t;
+using std::uint64_t;
+using std::vector;
+
+/// The lines of a text as sequences of words, i.e., of strings of printable
+/// ASCII characters, except space, that are delimited by whitespace. The words
+/// are views into the bytes of the text, which must outlive the object, so that
+/// no word is allocated on its own. The empty lines at the end of the text are
+/// ignored, as are the whitespace characters other than newlines.
+class WordLines
+{
+    private:
+        vector<string_view> mWords; ///< The words of all lines, in order.
+        vector<size_t> mLineStarts; ///< The first word of each line, and the end.
+        bool mIsValid;              ///< The underlying field for isValid().
+
+    public:
+        /// Splits a range of bytes into lines of words. The splitting stops at
+        /// the first byte that is neither whitespace nor printable, after which
+        /// the object is invalid.
+        /// @param begin The first byte.
+        /// @param end   One past the last byte.
+        WordLines(const char *begin, const char *end) :
+              mWords(), mLineStarts(1, 0), mIsValid(true)
+        {
+            const char *p = begin;
+
+            while (p != end)
+            {
+                if (*p == '\n')
+                {
+                    p++;
+                    mLineStarts.push_back(mWords.size());
+                }
+                else if (isSpaceChar(static_cast<unsigned char>(*p)))
+                {
+                    p++;
+                }
+                else if ('!' <= *p && *p <= '~')
+                {
+                    const char *word = p;
+
+                    while (p != end && '!' <= *p && *p <= '~')
+                    {
+                        p++;
+                    }
+
+                    mWords.emplace_back(word, static_cast<size_t>(p - word));
+                }
+                else
+                {
+                    mIsValid = false;
+                    break;
+                }
+            }
+
+            // Keep the invalid line, so that it can be reported.
+            if (mIsValid)
+            {
+                while (!mLineStarts.empty() && mLineStarts.back() == mWords.size())
+                {
+                    mLineStarts.pop_back();
+                }
+            }
+
+            mLineStarts.push_back(mWords.size());
+        }
+
+        /// Whether the text is made only of whitespace and printable characters.
+        /// If not, the last line is the one of the first other character.
+        bool isValid() const
+        {
+            return mIsValid;
+        }
+
+        /// The number of lines.
+        size_t lines() const
+        {
+            return mLineStarts.size() - 1;
+        }
+
+        /// The number of words in a line.
+        /// @param line The index of the line, from 0.
+        size_t words(size_t line) const
+        {
+            return mLineStarts[line + 1] - mLineStarts[line];
+        }
+
+        /// A word of a line.
+        /// @param line The index of the line, from 0.
+        /// @param word The index of the word within the line, from 0.
+        string_view word(size_t line, size_t word) const
+        {
+            return mWords[mLineStarts[line] + word];
+        }
+
+        /// Whether a line is equal to a line of another text.
+        /// @param line  The index of the line, from 0.
+        /// @param other The other text.
+        /// @param otherLine The index of the line of the other text, from 0.
+        bool isEqual(size_t line, const WordLines &other, size_t otherLine) const
+        {
+            return std::equal(mWords.begin() + mLineStarts[line],
+                              mWords.begin() + mLineStarts[line + 1],
+                              other.mWords.begin() + other.mLineStarts[otherLine],
+                              other.mWords.begin() + other.mLineStarts[otherLine + 1]);
+        }
+
+        /// The FNV-1a hash of a line, which separates the words.
+        /// @param line The index of the line, from 0.
+        uint64_t hash(size_t line) const
+        {
+            uint64_t hash = 0xcbf29ce484222325;
+
+            for (size_t i = mLineStarts[line]; i < mLineStarts[line + 1]; i++)
+            {
+                for (char c : mWords[i])
+                {
+                    hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001b3;
+                }
+
+                hash = (hash ^ ' ') * 0x100000001b3;
+            }
+
+            return hash;
+        }
+};
+
+/// An open-addressing hash table that numbers the distinct lines of one or more
+/// texts (see WordLines) from 0, so that lines are compared as numbers. Equal
+/// lines get the same number.
+class LineInterner
+{
+    private:
+        /// A slot of the table, which refers to the first line with a number.
+        struct Slot
+        {
+            uint64_t hash;          ///< The hash of the line.
+            const WordLines *lines; ///< The text of the line, or nullptr if free.
+            size_t line;            ///< The index of the line in the text.
+            uint32_t id;            ///< The number of the line.
+        };
+
+        vector<Slot> mSlots; ///< The slots, whose count is a power of two.
+        uint32_t mCount;     ///< The underlying field for size().
+
+    public:
+        /// Constructs an empty table.
+        /// @param capacity The number of lines that are to be numbered.
+        LineInterner(size_t capacity) :
+              mSlots(std::bit_ceil(2 * capacity + 1)), mCount(0)
+        {
+        }
+
+        /// The number of distinct lines so far.
+        uint32_t size() const
+        {
+            return mCount;
+        }
+
+        /// Returns the number of a line, numbering it if it is new. Must not be
+        /// called for more lines than the capacity.
+        /// @param lines The text of the line.
+        /// @param line  The index of the line in the text.
+        uint32_t intern(const WordLines &lines, size_t line)
+        {
+            uint64_t hash = lines.hash(line);
+            size_t mask = mSlots.size() - 1;
+
+            for (size_t i = static_cast<size_t>(hash) & mask; ; i = (i + 1) & mask)
+            {
+                Slot &slot = mSlots[i];
+
+                if (slot.lines == nullptr)
+                {
+                    slot = Slot{hash, &lines, line, mCount};
+                    return mCount++;
+                }
+                else if (slot.hash == hash && lines.isEqual(line, *slot.lines, slot.line))
+                {
+                    return slot.id;
+                }
+            }
+        }
+};
+
+/// Computes the edit distance, with insertions and deletions only, of two
+/// sequences with the greedy algorithm of Myers, in O((n + m) * D) time and
+/// O(D) memory for a distance of D.
+/// @param a        The first sequence.
+/// @param n        The length of the first sequence.
+/// @param b        The second sequence.
+/// @param m        The length of the second sequence.
+/// @param maxDistance The distance up to which to search.
+/// @param distance Set to the distance, if it is at most maxDistance.
+/// @return Whether the distance is at most maxDistance.
+inline bool myersDistance(const uint32_t *a, size_t n, const uint32_t *b, size_t m,
+                          size_t maxDistance, size_t &distance)
+{
+    // The furthest x reached on each diagonal k = x - y, offset by maxDistance + 1.
+    vector<size_t> furthest(2 * maxDistance + 3, 0);
+    const size_t offset = maxDistance + 1;
+
+    for (size_t d = 0; d <= maxDistance; d++)
+    {
+        for (size_t i = 0; i <= d; i++)
+        {
+            size_t k = offset + 2 * i - d;  // The diagonal, from -d to d by 2.
+            size_t x;
+
+            if (i == 0 || (i != d && furthest[k - 1] < furthest[k + 1]))
+            {
+                x = furthest[k + 1];        // A deletion from b, from k + 1.
+            }
+            else
+            {
+                x = furthest[k - 1] + 1;    // A deletion from a, from k - 1.
+            }
+
+            size_t y = x + offset - k;
+
+            while (x < n && y < m && a[x] == b[y])
+            {
+                x++;
+                y++;
+            }
+
+            furthest[k] = x;
+
+            if (x >= n && y >= m)
+            {
+                distance = d;
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+/// Computes the length of the longest common subsequence of two sequences with
+/// the bit-parallel algorithm of Hyyrö, in O(n * m / 64) time. The masks of the
+/// symbols of the first sequence are stored sparsely, in O(n + m) memory, which
+/// also lets each step skip the words of the bit vector that do not change.
+/// @param a       The first sequence.
+/// @param n       The length of the first sequence.
+/// @param b       The second sequence.
+/// @param m       The length of the second sequence.
+/// @param symbols The number of symbols, i.e., one more than the largest one.
+inline size_t bitParallelLcs(const uint32_t *a, size_t n, const uint32_t *b, size_t m,
+                             uint32_t symbols)
+{
+    // The nonzero words of the mask of each symbol, i.e., of the bits of the
+    // positions of a with the symbol, ordered by symbol and then by word.
+    vector<size_t> maskStarts(static_cast<size_t>(symbols) + 1, 0);
+    vector<std::pair<size_t, uint64_t>> masks;
+
+    for (size_t x = 0; x < n; x++)
+    {
+        maskStarts[a[x] + 1]++;
+    }
+
+    for (uint32_t s = 0; s < symbols; s++)
+    {
+        maskStarts[s + 1] += maskStarts[s];
+    }
+
+    vector<size_t> positions(n);
+    vector<size_t> next(maskStarts.begin(), maskStarts.end() - 1);
+
+    for (size_t x = 0; x < n; x++)
+    {
+        positions[next[a[x]]++] = x;
+    }
+
+    for (uint32_t s = 0; s < symbols; s++)
+    {
+        size_t start = masks.size();
+
+        for (size_t i = maskStarts[s]; i < maskStarts[s + 1]; i++)
+        {
+            size_t word = positions[i] / 64;
+            uint64_t bit = uint64_t(1) << (positions[i] % 64);
+
+            if (masks.size() > start && masks.back().first == word)
+            {
+                masks.back().second |= bit;
+            }
+            else
+            {
+                masks.emplace_back(word, bit);
+            }
+        }
+
+        maskStarts[s] = start;
+    }
+
+    maskStarts[symbols] = masks.size();
+
+    // The zero bits mark the positions of a that end the longest
+    // common subsequences so far. The words before the first nonzero word of a
+    // mask do not change, and neither do the ones after the carry dies out.
+    const size_t words = (n + 63) / 64;
+    vector<uint64_t> bits(words, ~uint64_t(0));
+
+    for (size_t y = 0; y < m; y++)
+    {
+        size_t entry = maskStarts[b[y]];
+        const size_t last = maskStarts[b[y] + 1];
+
+        if (entry == last)
+        {
+            continue;
+        }
+
+        uint64_t carry = 0;
+
+        for (size_t k = masks[entry].first; k < words && (entry != last || carry != 0); k++)
+        {
+            uint64_t mask = 0;
+
+            if (entry != last && masks[entry].first == k)
+            {
+                mask = masks[entry++].second;
+            }
+
+            uint64_t v = bits[k];
+            uint64_t sum = v + (v & mask);
+            uint64_t carried = sum + carry;
+
+            carry = (sum < v || carried < sum) ? 1 : 0;
+            bits[k] = carried | (v & ~mask);
+        }
+    }
+
+    size_t ones = 0;
+
+    for (size_t k = 0; k < words; k++)
+    {
+        uint64_t v = bits[k];
+
+        if (k == words - 1 && n % 64 != 0)
+        {
+            v &= (uint64_t(1) << (n % 64)) - 1;
+        }
+
+        ones += static_cast<size_t>(std::popcount(v));
+    }
+
+    return n - ones;
+}
+
+/// Computes the length of the longest common subsequence of two sequences in
+/// linear memory. The common prefix and suffix are skipped. Then, the greedy
+/// algorithm of Myers runs for as long as it is expected to be faster than the
+/// bit-parallel one, which is fast if the sequences are nearly equal, and the
+/// bit-parallel one runs otherwise. (See myersDistance and bitParallelLcs.)
+/// @param a       The first sequence.
+/// @param n       The length of the first sequence.
+/// @param b       The second sequence.
+/// @param m       The length of the second sequence.
+/// @param symbols The number of symbols, i.e., one more than the largest one.
+inline size_t longestCommonSubsequence(const uint32_t *a, size_t n,
+                                       const uint32_t *b, size_t m,
+                                       uint32_t symbols)
+{
+    size_t common = 0;
+
+    while (n > 0 && m > 0 && a[0] == b[0])
+    {
+        a++;
+        b++;
+        n--;
+        m--;
+        common++;
+    }
+
+    while (n > 0 && m > 0 && a[n - 1] == b[m - 1])
+    {
+        n--;
+        m--;
+        common++;
+    }
+
+    if (n == 0 || m == 0)
+    {
+        return common;
+    }
+
+    // The greedy algorithm takes up to (n + m) steps per distance, and the
+    // bit-parallel one (n + 63) / 64 steps per symbol of b.
+    size_t maxDistance = std::max<size_t>(1, m * ((n + 63) / 64) / (n + m));
+    size_t distance;
+
+    if (myersDistance(a, n, b, m, maxDistance, distance))
+    {
+        return common + (n + m - distance) / 2;
+    }
+
+    return common + bitParallelLcs(a, n, b, m, symbols);
+}
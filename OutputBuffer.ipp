@@ -0,0 +1,212 @@
+// Author: Hakan Yıldız
+// Shared under MIT License. See the file LICENSE for more info.
+
+/// @file OutputBuffer.ipp
+/// Implements the OutputBuffer class.
+
+#pragma once
+
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+using std::size_t;
+using std::string;
+using std::string_view;
+using std::uint64_t;
+
+/// The header of a record of the --binary-server mode (see OutputBuffer::flushRecord),
+/// in the byte order of the machine.
+struct RecordHeader
+{
+    double gradeRatio; ///< The grade ratio, or -1 if the checker failed.
+    uint64_t length;   ///< The number of bytes of the message that follows.
+};
+
+/// A buffer for the output of a checker for a test case, which is written with
+/// a single system call (see flush()) rather than through std::cout, so that
+/// the reader of a pipe gets the output at once. The output is cut beyond a
+/// given number of bytes, and a marker is written in place of the rest.
+class OutputBuffer
+{
+    private:
+        /// The marker that is written in place of the bytes that were not kept.
+        static constexpr string_view Marker = "\n.....\n";
+
+        string mBytes;    ///< The bytes so far, up to mMaxBytes.
+        size_t mMaxBytes; ///< The number of bytes to keep.
+        bool mIsCut;      ///< Whether some bytes were not kept.
+
+        /// Writes a number of parts with a single writev() call, unless the
+        /// descriptor takes them partially.
+        /// @param fd    The descriptor to write to.
+        /// @param parts The parts, which are consumed.
+        /// @param count The number of parts.
+        /// @return Whether all of the bytes were written.
+        static bool writeParts(int fd, iovec *parts, int count)
+        {
+            int first = 0;
+
+            while (first < count)
+            {
+                ssize_t written = writev(fd, parts + first, count - first);
+
+                if (written < 0)
+                {
+                    if (errno == EINTR)
+                    {
+                        continue;
+                    }
+
+                    return false;
+                }
+
+                // Skip what was written, in case the write was partial.
+                size_t left = static_cast<size_t>(written);
+
+                while (first < count && left >= parts[first].iov_len)
+                {
+                    left -= parts[first].iov_len;
+                    first++;
+                }
+
+                if (first < count)
+                {
+                    parts[first].iov_base = static_cast<char *>(parts[first].iov_base) + left;
+                    parts[first].iov_len -= left;
+                }
+            }
+
+            return true;
+        }
+
+    public:
+        /// Constructs an empty buffer.
+        /// @param maxBytes The number of bytes to keep.
+        explicit OutputBuffer(size_t maxBytes) :
+              mBytes(), mMaxBytes(maxBytes), mIsCut(false)
+        {
+            mBytes.reserve(maxBytes);
+        }
+
+        OutputBuffer(const OutputBuffer &) = delete;
+        OutputBuffer & operator=(const OutputBuffer &) = delete;
+
+        /// Appends a range of characters, as far as they fit.
+        /// @param data  The first character.
+        /// @param count The number of characters.
+        void append(const char *data, size_t count)
+        {
+            size_t kept = std::min(count, mMaxBytes - mBytes.size());
+
+            mBytes.append(data, kept);
+            mIsCut = mIsCut || kept < count;
+        }
+
+        /// Appends a character. See append().
+        OutputBuffer & operator<<(char c)
+        {
+            append(&c, 1);
+            return *this;
+        }
+
+        /// Appends a string. See append().
+        OutputBuffer & operator<<(string_view text)
+        {
+            append(text.data(), text.size());
+            return *this;
+        }
+
+        /// Appends a null-terminated string. See append().
+        OutputBuffer & operator<<(const char *text)
+        {
+            return *this << string_view(text);
+        }
+
+        /// Appends an integer in decimal. See append().
+        template<typename T>
+        std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool> &&
+                         !std::is_same_v<T, char>, OutputBuffer &>
+        operator<<(T value)
+        {
+            char text[24];
+            auto result = std::to_chars(text, text + sizeof(text), value);
+
+            append(text, static_cast<size_t>(result.ptr - text));
+            return *this;
+        }
+
+        /// Discards the bytes so far.
+        void clear()
+        {
+            mBytes.clear();
+            mIsCut = false;
+        }
+
+        /// Writes the bytes so far, followed by "....." if some were cut and then
+        /// by a suffix, with a single writev() call unless the descriptor takes
+        /// them partially, and discards them.
+        /// @param fd     The descriptor to write to.
+        /// @param suffix The bytes to write after the buffer, which are not cut.
+        /// @return Whether all of the bytes were written.
+        bool flush(int fd, string_view suffix = {})
+        {
+            iovec parts[3] = {
+                {mBytes.data(), mBytes.size()},
+                {const_cast<char *>(Marker.data()), mIsCut ? Marker.size() : 0},
+                {const_cast<char *>(suffix.data()), suffix.size()}
+            };
+            bool success = writeParts(fd, parts, 3);
+
+            clear();
+            return success;
+        }
+
+        /// Writes the bytes so far as a record of the --binary-server mode, and
+        /// discards them. The record is a RecordHeader with the grade ratio (i.e.,
+        /// the number before the first '|') and the length of the message (i.e.,
+        /// the rest, followed by "....." if some bytes were cut), followed by the
+        /// message, so that the reader gets the grade ratio without parsing the
+        /// message. See flush().
+        /// @param fd       The descriptor to write to.
+        /// @param isFailed Whether the checker failed, in which case the grade
+        ///                 ratio is -1 and the message is empty.
+        /// @return Whether all of the bytes were written.
+        bool flushRecord(int fd, bool isFailed)
+        {
+            RecordHeader header{-1, 0};
+            size_t bar = mBytes.find('|');
+            size_t begin = mBytes.size();
+
+            if (!isFailed && bar != string::npos &&
+                std::from_chars(mBytes.data(), mBytes.data() + bar, header.gradeRatio).ptr ==
+                    mBytes.data() + bar)
+            {
+                begin = bar + 1;
+                header.length = (mBytes.size() - begin) + (mIsCut ? Marker.size() : 0);
+            }
+            else
+            {
+                header.gradeRatio = -1;
+                mIsCut = false;
+            }
+
+            iovec parts[3] = {
+                {&header, sizeof(header)},
+                {mBytes.data() + begin, mBytes.size() - begin},
+                {const_cast<char *>(Marker.data()), mIsCut ? Marker.size() : 0}
+            };
+            bool success = writeParts(fd, parts, 3);
+
+            clear();
+            return success;
+        }
+};
@@ -0,0 +1,361 @@
+// Author: Hakan Yıldız
+// Shared under MIT License. See the file LICENSE for more info.
+
+/// @file ParallelCompare.ipp
+/// Implements a parallel pre-pass for diff_checker_base.ipp, which finds the
+/// part of two large, memory-resident inputs where their tokens may differ.
+///
+/// Both inputs are split into chunks that start after the same line break,
+/// i.e., after the same newline that the Tokenizer returns as a Newline token.
+/// A newline is a line break, unless it is the last byte of the input, or it
+/// is in a whitespace run in which a character other than space or newline
+/// precedes it: the Tokenizer then skips the rest of the run while reading the
+/// next value. The chunks are compared on a thread pool, in order, and the
+/// chunks after the first differing one are cancelled. Since the line breaks
+/// of the two inputs only correspond while their tokens are equal, the first
+/// differing chunk pair contains the first mismatch, and the caller finds it by
+/// tokenizing sequentially from there, with the line numbers from a prefix sum
+/// of the line breaks in the preceding chunks.
+///
+/// This requires that values (see Parse.ipp) neither contain nor consume
+/// whitespace, which holds for the tokenizers in Tokenizer.ipp.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "Tokenizer.ipp"
+
+using std::atomic;
+using std::size_t;
+using std::uint64_t;
+using std::vector;
+
+/// The approximate size of the chunks that are compared in parallel.
+constexpr size_t ParallelChunkBytes = size_t(8) << 20;
+
+/// The position that stands for a line break that does not exist.
+constexpr size_t NoLineBreak = ~size_t(0);
+
+/// Runs a function on the indices 0, ..., count - 1 on a number of threads.
+/// The indices are started in increasing order.
+/// @param count The number of indices.
+/// @param threads The number of threads.
+/// @param function The function to call with each index.
+template<typename Function>
+void parallelFor(size_t count, unsigned threads, Function function)
+{
+    atomic<size_t> next(0);
+    vector<std::thread> pool;
+
+    for (unsigned i = 0; i < std::min<size_t>(threads, count); i++)
+    {
+        pool.emplace_back([&]()
+        {
+            for (size_t index; (index = next.fetch_add(1)) < count;)
+            {
+                function(index);
+            }
+        });
+    }
+
+    for (std::thread &thread : pool)
+    {
+        thread.join();
+    }
+}
+
+/// Finds the first position at or after a given one that follows a line break
+/// and holds a character other than whitespace. The Tokenizer reads a token
+/// from such a position after reading the line break, regardless of what
+/// precedes the whitespace run of the line break.
+/// @param data The input.
+/// @param size The size of the input.
+/// @param from The position to start searching from.
+/// @return The position, or size if there is none.
+inline size_t nextResyncPoint(const char *data, size_t size, size_t from)
+{
+    // The newline is searched from this position, excluding the last byte.
+    size_t search = std::max<size_t>(from, 1) - 1;
+
+    while (search + 1 < size)
+    {
+        const void *newline = std::memchr(data + search, '\n', size - 1 - search);
+
+        if (newline == nullptr)
+        {
+            return size;
+        }
+
+        size_t i = static_cast<size_t>(static_cast<const char *>(newline) - data) + 1;
+
+        search = i;
+
+        if (isSpaceChar(static_cast<unsigned char>(data[i])))
+        {
+            continue;
+        }
+
+        // The newline is a line break if its whitespace run only has spaces
+        // and newlines before it.
+        size_t j = i - 1;
+
+        while (j > 0 && (data[j - 1] == ' ' || data[j - 1] == '\n'))
+        {
+            j--;
+        }
+
+        if (j == 0 || !isSpaceChar(static_cast<unsigned char>(data[j - 1])))
+        {
+            return i;
+        }
+    }
+
+    return size;
+}
+
+/// Finds the line breaks in a part of an input that starts at the beginning of
+/// the input or at a resync point (see nextResyncPoint()).
+/// @param data The input.
+/// @param size The size of the input.
+/// @param begin The beginning of the part.
+/// @param end The end of the part.
+/// @param onLineBreak The function to call with the position after each line
+///                    break.
+template<typename Function>
+void scanLineBreaks(const char *data, size_t size, size_t begin, size_t end,
+                    Function onLineBreak)
+{
+    bool skipping = false; // Whether the Tokenizer skips the newlines.
+
+    for (size_t i = begin; i < end; i++)
+    {
+        unsigned char c = static_cast<unsigned char>(data[i]);
+
+        if (c == '\n')
+        {
+            if (!skipping && i + 1 < size)
+            {
+                onLineBreak(i + 1);
+            }
+        }
+        else if (c != ' ')
+        {
+            skipping = isSpaceChar(c);
+        }
+    }
+}
+
+/// Splits an input into parts that start at resync points, and counts the line
+/// breaks in the parts on a number of threads.
+/// @param data The input.
+/// @param size The size of the input.
+/// @param parts The number of parts to aim for.
+/// @param threads The number of threads.
+/// @param starts Set to the beginnings of the parts.
+/// @param lineBreaks Set to the number of line breaks before each part, with
+///                   one more element for the total.
+inline void splitAndCount(const char *data, size_t size, size_t parts,
+                          unsigned threads, vector<size_t> &starts,
+                          vector<uint64_t> &lineBreaks)
+{
+    starts.assign(1, 0);
+
+    for (size_t i = 1; i < parts; i++)
+    {
+        size_t start = nextResyncPoint(data, size, std::max(starts.back() + 1,
+                                                            size / parts * i));
+
+        if (start >= size)
+        {
+            break;
+        }
+
+        starts.push_back(start);
+    }
+
+    lineBreaks.assign(starts.size() + 1, 0);
+
+    parallelFor(starts.size(), threads, [&](size_t i)
+    {
+        size_t end = (i + 1 < starts.size()) ? starts[i + 1] : size;
+        uint64_t count = 0;
+
+        scanLineBreaks(data, size, starts[i], end, [&](size_t) { count++; });
+        lineBreaks[i + 1] = count;
+    });
+
+    for (size_t i = 1; i < lineBreaks.size(); i++)
+    {
+        lineBreaks[i] += lineBreaks[i - 1];
+    }
+}
+
+/// Compares the tokens of a chunk pair. An input that does not end with its
+/// chunk (i.e., its chunk is not final) ends the chunk with a line break, which
+/// the Tokenizer reads as the end of the file: It is taken as a newline.
+/// @param claimed The claimed chunk.
+/// @param claimedEnd The end of the claimed chunk.
+/// @param claimedFinal Whether the claimed chunk ends the claimed input.
+/// @param correct The correct chunk.
+/// @param correctEnd The end of the correct chunk.
+/// @param correctFinal Whether the correct chunk ends the correct input.
+/// @param equal The equal policy to compare the tokens with.
+/// @param cancelled Returns whether the comparison is no longer needed.
+/// @return Whether the tokens are equal, or the comparison was cancelled.
+template<typename Tokenizer, typename Cancelled>
+bool chunksEqual(const char *claimed, const char *claimedEnd, bool claimedFinal,
+                 const char *correct, const char *correctEnd, bool correctFinal,
+                 const typename Tokenizer::EqualType &equal,
+                 Cancelled cancelled)
+{
+    ByteInput claimedInput(claimed, claimedEnd);
+    ByteInput correctInput(correct, correctEnd);
+    Tokenizer claimedTokenizer(claimedInput);
+    Tokenizer correctTokenizer(correctInput);
+
+    for (uint64_t count = 0; ; count++)
+    {
+        if (count % 4096 == 0 && cancelled())
+        {
+            return true;
+        }
+
+        auto claimedToken = claimedTokenizer.next();
+        auto correctToken = correctTokenizer.next();
+        bool claimedEnds = (claimedToken.kind() == Tokenizer::TokenKind::EndOfFile);
+        bool correctEnds = (correctToken.kind() == Tokenizer::TokenKind::EndOfFile);
+
+        if (claimedToken.kind() == Tokenizer::TokenKind::Invalid ||
+            correctToken.kind() == Tokenizer::TokenKind::Invalid)
+        {
+            return false;
+        }
+        else if (claimedEnds || correctEnds)
+        {
+            return claimedEnds && correctEnds && claimedFinal == correctFinal;
+        }
+        else if (!correctToken.isEqual(claimedToken, equal))
+        {
+            return false;
+        }
+    }
+}
+
+/// The result of parallelSearch().
+struct ParallelSearchResult
+{
+    bool mayDiffer;       ///< Whether the tokens of the inputs may differ.
+    size_t claimedOffset; ///< Where to tokenize the claimed input from.
+    size_t correctOffset; ///< Where to tokenize the correct input from.
+    uint64_t lines;       ///< The number of line breaks before the offsets.
+};
+
+/// Finds where the tokens of two inputs may start to differ. See the
+/// documentation of ParallelCompare.ipp.
+/// @param claimed The claimed input.
+/// @param claimedSize The size of the claimed input.
+/// @param correct The correct input.
+/// @param correctSize The size of the correct input.
+/// @param equal The equal policy to compare the tokens with.
+/// @param threads The number of threads.
+template<typename Tokenizer>
+ParallelSearchResult parallelSearch(const char *claimed, size_t claimedSize,
+                                    const char *correct, size_t correctSize,
+                                    const typename Tokenizer::EqualType &equal,
+                                    unsigned threads)
+{
+    size_t parts = std::max<size_t>(threads, correctSize / ParallelChunkBytes);
+
+    // The chunks of the correct input start at its resync points.
+    vector<size_t> correctStarts;
+    vector<uint64_t> correctLineBreaks;
+
+    splitAndCount(correct, correctSize, parts, threads, correctStarts,
+                  correctLineBreaks);
+
+    // The chunks of the claimed input start after the same line breaks, which
+    // are located within the parts of the claimed input that contain them.
+    vector<size_t> claimedParts;
+    vector<uint64_t> partLineBreaks;
+    size_t chunks = correctStarts.size();
+    vector<size_t> claimedStarts(chunks, NoLineBreak);
+
+    splitAndCount(claimed, claimedSize, parts, threads, claimedParts,
+                  partLineBreaks);
+    claimedStarts[0] = 0;
+
+    parallelFor(claimedParts.size(), threads, [&](size_t i)
+    {
+        size_t end = (i + 1 < claimedParts.size()) ? claimedParts[i + 1] : claimedSize;
+        size_t chunk = std::upper_bound(correctLineBreaks.begin(),
+                                        correctLineBreaks.begin() + chunks,
+                                        partLineBreaks[i]) - correctLineBreaks.begin();
+        uint64_t count = partLineBreaks[i];
+
+        if (chunk >= chunks || correctLineBreaks[chunk] > partLineBreaks[i + 1])
+        {
+            return;
+        }
+
+        scanLineBreaks(claimed, claimedSize, claimedParts[i], end, [&](size_t position)
+        {
+            count++;
+
+            if (chunk < chunks && correctLineBreaks[chunk] == count)
+            {
+                claimedStarts[chunk++] = position;
+            }
+        });
+    });
+
+    // Compare the chunks, cancelling the ones after a differing chunk.
+    atomic<size_t> firstDiffering(chunks);
+
+    parallelFor(chunks, threads, [&](size_t i)
+    {
+        auto cancelled = [&]() { return firstDiffering.load() < i; };
+
+        if (cancelled() || claimedStarts[i] == NoLineBreak)
+        {
+            return;
+        }
+
+        bool correctFinal = (i + 1 == chunks);
+        bool claimedFinal = correctFinal || claimedStarts[i + 1] == NoLineBreak;
+        size_t correctEnd = correctFinal ? correctSize : correctStarts[i + 1];
+        size_t claimedEnd = claimedFinal ? claimedSize : claimedStarts[i + 1];
+
+        if (!chunksEqual<Tokenizer>(claimed + claimedStarts[i], claimed + claimedEnd,
+                                    claimedFinal,
+                                    correct + correctStarts[i], correct + correctEnd,
+                                    correctFinal, equal, cancelled))
+        {
+            size_t current = firstDiffering.load();
+
+            while (i < current && !firstDiffering.compare_exchange_weak(current, i))
+            {
+            }
+        }
+    });
+
+    size_t differing = firstDiffering.load();
+
+    if (differing == chunks)
+    {
+        return {false, 0, 0, 0};
+    }
+
+    // Start from the chunk before the differing one, so that the lines before
+    // the mismatch can be shown.
+    size_t start = (differing > 0) ? differing - 1 : 0;
+
+    return {true, claimedStarts[start], correctStarts[start],
+            correctLineBreaks[start]};
+}
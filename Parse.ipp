@@ -0,0 +1,511 @@
+// Author: Hakan Yıldız
+// Shared under MIT License. See the file LICENSE for more info.
+
+/// @file Parse.ipp
+/// Implements the parse policies with which a Tokenizer reads values from the
+/// bytes of a ByteInput (see Input.ipp). A policy provides:
+///     static constexpr bool ReadsWord;
+///         Whether parse() may read up to the end of a whitespace-delimited
+///         word, rather than a single byte.
+///     bool parse(const char *&pos, const char *end, T &value);
+///         Parses a value at pos, which is not whitespace, and advances pos
+///         past it. Returns whether the value could be parsed.
+/// The StreamInput backend always reads with operator>>, ignoring the policy.
+
+#pragma once
+
+#include <array>
+#include <bit>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <streambuf>
+#include <string>
+#include <system_error>
+#include <type_traits>
+
+#include "Integer.ipp"
+
+using std::array;
+using std::istream;
+using std::numeric_limits;
+using std::size_t;
+using std::streambuf;
+using std::string;
+using std::uint64_t;
+
+/// A parse policy that reads a single byte as a char.
+class CharParse
+{
+    public:
+        static constexpr bool ReadsWord = false; ///< See Parse.ipp.
+
+        /// Parses a char. See Parse.ipp.
+        bool parse(const char *&pos, const char *, char &value)
+        {
+            value = *pos++;
+            return true;
+        }
+};
+
+/// A parse policy that reads with operator>>, directly over the bytes.
+class StreamParse
+{
+    private:
+        /// A streambuf to run operator>> over a range of bytes without copying.
+        class ViewBuffer : public streambuf
+        {
+            public:
+                /// Sets the range to read from.
+                void reset(const char *begin, const char *end)
+                {
+                    char *b = const_cast<char *>(begin);
+                    setg(b, b, const_cast<char *>(end));
+                }
+
+                /// The number of bytes consumed since the last reset().
+                size_t consumed() const
+                {
+                    return static_cast<size_t>(gptr() - eback());
+                }
+        };
+
+        ViewBuffer mViewBuffer; ///< The view over the bytes to parse.
+        istream mViewStream;    ///< The stream over mViewBuffer.
+
+    public:
+        static constexpr bool ReadsWord = true; ///< See Parse.ipp.
+
+        StreamParse() :
+              mViewBuffer(), mViewStream(&mViewBuffer)
+        {
+        }
+
+        StreamParse(const StreamParse &) = delete;
+        StreamParse & operator=(const StreamParse &) = delete;
+
+        /// Parses a value with operator>>. See Parse.ipp.
+        template<typename T>
+        bool parse(const char *&pos, const char *end, T &value)
+        {
+            mViewBuffer.reset(pos, end);
+            mViewStream.clear();
+            mViewStream >> value;
+            pos += mViewBuffer.consumed();
+            return !mViewStream.fail();
+        }
+};
+
+/// The default parse policy for a given value type.
+template<typename T>
+using DefaultParse = std::conditional_t<std::is_same_v<T, char>,
+                                        CharParse,
+                                        StreamParse>;
+
+/// A locale-free, allocation-free parse policy for decimal floating-point
+/// numbers. It accepts exactly what operator>> accepts in the "C" locale, i.e.:
+///     [+-]? [0-9]* ([.] [0-9]*)? ([eE] [+-]? [0-9]+)?
+/// with at least one digit in the mantissa, rejecting numbers that overflow.
+/// Numbers with at most 19 significant digits and a small decimal exponent are
+/// converted with a single correctly rounded multiplication or division, the
+/// others with std::from_chars. Numbers that underflow are read as zero.
+/// @tparam T The floating-point type to parse into.
+template<typename T>
+class DecimalParse
+{
+    private:
+        static_assert(std::is_floating_point_v<T>);
+
+        /// The largest significand that is exactly representable in T.
+        static constexpr uint64_t MaxExactMantissa =
+            numeric_limits<T>::digits >= 64 ? ~uint64_t(0)
+                                            : (uint64_t(1) << numeric_limits<T>::digits);
+
+        /// The largest k such that 10^k is exactly representable in T, i.e.,
+        /// such that 5^k fits into the significand.
+        static constexpr int MaxExactPower = []()
+        {
+            int k = 0;
+
+            for (uint64_t power = 5; power <= MaxExactMantissa; power *= 5)
+            {
+                k++;
+
+                if (power > MaxExactMantissa / 5)
+                {
+                    break;
+                }
+            }
+
+            return k;
+        }();
+
+        /// The powers of 10 that are exactly representable in T.
+        static constexpr array<T, MaxExactPower + 1> PowersOfTen = []()
+        {
+            array<T, MaxExactPower + 1> powers {};
+
+            powers[0] = 1;
+
+            for (int i = 1; i <= MaxExactPower; i++)
+            {
+                powers[i] = powers[i - 1] * 10;
+            }
+
+            return powers;
+        }();
+
+        /// Whether a character is a decimal digit.
+        static bool isDigit(char c)
+        {
+            return '0' <= c && c <= '9';
+        }
+
+    public:
+        static constexpr bool ReadsWord = true; ///< See Parse.ipp.
+
+        /// Parses a decimal number. See Parse.ipp and DecimalParse.
+        bool parse(const char *&pos, const char *end, T &value)
+        {
+            const char *p = pos;
+            bool negative = false;
+
+            if (p != end && (*p == '+' || *p == '-'))
+            {
+                negative = (*p == '-');
+                p++;
+            }
+
+            const char *digitsBegin = p;
+            uint64_t mantissa = 0;
+            int significant = 0; // Significant digits in mantissa.
+            int exponent = 0;    // Decimal exponent to apply to mantissa.
+            int magnitude = 0;   // Digits before the point, after leading zeros.
+            bool foundMantissa = false;
+            bool truncated = false;
+
+            for (; p != end && isDigit(*p); p++)
+            {
+                foundMantissa = true;
+
+                if (significant == 0 && *p == '0')
+                {
+                    continue;
+                }
+
+                magnitude++;
+
+                if (significant < 19)
+                {
+                    mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+                    significant++;
+                }
+                else
+                {
+                    exponent++;
+                    truncated |= (*p != '0');
+                }
+            }
+
+            if (p != end && *p == '.')
+            {
+                p++;
+
+                for (; p != end && isDigit(*p); p++)
+                {
+                    foundMantissa = true;
+
+                    if (significant == 0 && *p == '0')
+                    {
+                        magnitude--;
+                        exponent--;
+                        continue;
+                    }
+
+                    if (significant < 19)
+                    {
+                        mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+                        significant++;
+                        exponent--;
+                    }
+                    else
+                    {
+                        truncated |= (*p != '0');
+                    }
+                }
+            }
+
+            if (!foundMantissa)
+            {
+                return false;
+            }
+
+            if (p != end && (*p == 'e' || *p == 'E'))
+            {
+                p++;
+
+                bool negativeExponent = false;
+
+                if (p != end && (*p == '+' || *p == '-'))
+                {
+                    negativeExponent = (*p == '-');
+                    p++;
+                }
+
+                if (p == end || !isDigit(*p))
+                {
+                    return false;
+                }
+
+                int scientific = 0;
+
+                for (; p != end && isDigit(*p); p++)
+                {
+                    if (scientific < 100000)
+                    {
+                        scientific = scientific * 10 + (*p - '0');
+                    }
+                }
+
+                exponent += negativeExponent ? -scientific : scientific;
+                magnitude += negativeExponent ? -scientific : scientific;
+            }
+
+            pos = p;
+
+            if (mantissa == 0)
+            {
+                value = negative ? -T(0) : T(0);
+                return true;
+            }
+
+            if (!truncated && mantissa <= MaxExactMantissa &&
+                -MaxExactPower <= exponent && exponent <= MaxExactPower)
+            {
+                T result = static_cast<T>(mantissa);
+
+                if (exponent >= 0)
+                {
+                    result *= PowersOfTen[exponent];
+                }
+                else
+                {
+                    result /= PowersOfTen[-exponent];
+                }
+
+                value = negative ? -result : result;
+                return true;
+            }
+
+            T result;
+            auto [ptr, ec] = std::from_chars(digitsBegin, p, result);
+
+            if (ec == std::errc::result_out_of_range)
+            {
+                if (magnitude > 0)
+                {
+                    return false;
+                }
+
+                result = T(0);
+            }
+            else if (ec != std::errc() || ptr != p)
+            {
+                return false;
+            }
+
+            value = negative ? -result : result;
+            return true;
+        }
+};
+
+/// A locale-free, allocation-free parse policy for decimal integers of any
+/// length (see Integer). It accepts:
+///     [+-]? [0-9]+
+/// i.e., what operator>> accepts for an integer in the "C" locale, but without
+/// overflow. The digits are scanned and converted 8 at a time, within a 64-bit
+/// word (SWAR), wherever 8 bytes can be loaded before the end of the range.
+class IntegerParse
+{
+    private:
+        /// Whether the SWAR code applies, i.e., the first loaded byte is the
+        /// lowest one.
+        static constexpr bool Swar = std::endian::native == std::endian::little;
+
+        /// The character '0' in each byte of a word.
+        static constexpr uint64_t Zeros = 0x3030303030303030;
+
+        /// The powers of 10 up to 10^8.
+        static constexpr array<uint64_t, 9> PowersOfTen = {
+            1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000
+        };
+
+        /// Whether a character is a decimal digit.
+        static bool isDigit(char c)
+        {
+            return '0' <= c && c <= '9';
+        }
+
+        /// Loads 8 bytes into a word.
+        static uint64_t load(const char *p)
+        {
+            uint64_t word;
+
+            std::memcpy(&word, p, sizeof(word));
+            return word;
+        }
+
+        /// The number of leading bytes of a word that are decimal digits.
+        static size_t leadingDigits(uint64_t word)
+        {
+            // A byte is a digit if its high nibble is 3 and its low nibble does
+            // not carry when 6 is added to it.
+            uint64_t high = (word & 0xF0F0F0F0F0F0F0F0) ^ Zeros;
+            uint64_t low = ((word & 0x0F0F0F0F0F0F0F0F) + 0x0606060606060606) &
+                           0xF0F0F0F0F0F0F0F0;
+
+            return static_cast<size_t>(std::countr_zero(high | low)) / 8;
+        }
+
+        /// The value of the leading digits of a word.
+        /// @param word  The word, whose leading bytes are digits.
+        /// @param count The number of the digits, from 1 to 8.
+        static uint64_t digitsValue(uint64_t word, size_t count)
+        {
+            // Move the digits to the top bytes, after leading '0' bytes, and add
+            // the digits in pairs, then in quadruples, and then in octets.
+            unsigned shift = static_cast<unsigned>(8 * (8 - count));
+
+            word = (word << shift) | (Zeros & ((uint64_t(1) << shift) - 1));
+            word -= Zeros;
+            word = (word * 10 + (word >> 8)) & 0x00FF00FF00FF00FF;
+            word = (word * 100 + (word >> 16)) & 0x0000FFFF0000FFFF;
+            return (word * 10000 + (word >> 32)) & 0x00000000FFFFFFFF;
+        }
+
+        /// The value of at most 19 digits, which fits into uint64_t.
+        /// @param p     The first digit.
+        /// @param count The number of digits.
+        /// @param end   The end of the range to parse, before which bytes may
+        ///              be loaded.
+        static uint64_t value(const char *p, size_t count, const char *end)
+        {
+            uint64_t result = 0;
+
+            if constexpr (Swar)
+            {
+                for (; count >= 8; p += 8, count -= 8)
+                {
+                    result = result * PowersOfTen[8] + digitsValue(load(p), 8);
+                }
+
+                if (count > 0 && end - p >= 8)
+                {
+                    return result * PowersOfTen[count] + digitsValue(load(p), count);
+                }
+            }
+
+            for (; count > 0; p++, count--)
+            {
+                result = result * 10 + static_cast<uint64_t>(*p - '0');
+            }
+
+            return result;
+        }
+
+    public:
+        static constexpr bool ReadsWord = true; ///< See Parse.ipp.
+
+        /// Parses a decimal integer. See Parse.ipp and IntegerParse.
+        bool parse(const char *&pos, const char *end, Integer &integer)
+        {
+            const char *p = pos;
+            bool negative = false;
+
+            if (p != end && (*p == '+' || *p == '-'))
+            {
+                negative = (*p == '-');
+                p++;
+            }
+
+            const char *digits = p;
+
+            if constexpr (Swar)
+            {
+                while (end - p >= 8)
+                {
+                    size_t count = leadingDigits(load(p));
+
+                    p += count;
+
+                    if (count < 8)
+                    {
+                        break;
+                    }
+                }
+            }
+
+            while (p != end && isDigit(*p))
+            {
+                p++;
+            }
+
+            if (p == digits)
+            {
+                return false;
+            }
+
+            pos = p;
+
+            while (p - digits > 1 && *digits == '0')
+            {
+                digits++;
+            }
+
+            size_t count = static_cast<size_t>(p - digits);
+
+            if (count <= 19)
+            {
+                uint64_t magnitude = value(digits, count, end);
+
+                if (magnitude <= static_cast<uint64_t>(numeric_limits<int64_t>::max()) + negative)
+                {
+                    integer = Integer(static_cast<int64_t>(negative ? 0 - magnitude : magnitude));
+                    return true;
+                }
+            }
+
+            integer = Integer(negative, string_view(digits, count));
+            return true;
+        }
+};
+
+/// Reads an Integer as IntegerParse does, for the StreamInput backend.
+inline istream & operator>>(istream &input, Integer &integer)
+{
+    string text;
+
+    input >> std::ws;
+
+    if (input.peek() == '+' || input.peek() == '-')
+    {
+        text += static_cast<char>(input.get());
+    }
+
+    while (input.peek() != EOF && '0' <= input.peek() && input.peek() <= '9')
+    {
+        text += static_cast<char>(input.get());
+    }
+
+    const char *pos = text.data();
+
+    if (!IntegerParse().parse(pos, text.data() + text.size(), integer))
+    {
+        input.setstate(std::ios_base::failbit);
+    }
+
+    return input;
+}
@@ -0,0 +1,318 @@
+// Author: Hakan Yıldız
+// Shared under MIT License. See the file LICENSE for more info.
+
+/// @file Policies.ipp
+/// Implements the validate and equal policies of a BasicTokenizer (see
+/// Tokenizer.ipp) for a value type T. A validate policy provides:
+///     bool operator()(const T &value) const;
+///         Whether a value is a valid token.
+/// An equal policy provides:
+///     bool operator()(const T &a, const T &b) const;
+///         Whether the values of two tokens are equal.
+/// Policies are default constructible classes, which may hold state given upon
+/// construction (e.g., a tolerance). Since the calls are resolved at compile
+/// time, they are inlined rather than made through a function pointer.
+///
+/// An equal policy may also provide:
+///     bool operator()(const T &a, const T &b, uint64_t column) const;
+///         Whether the values of two tokens in a given column, i.e., with as
+///         many values before them within their line (see Token::column()),
+///         are equal, which Token::isEqual() calls instead of the other form.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using std::istream;
+using std::shared_ptr;
+using std::size_t;
+using std::string;
+using std::uint64_t;
+using std::vector;
+
+/// A validate policy that calls a given predicate.
+/// @tparam VAL The predicate that checks whether a given value is valid.
+template<typename T, bool VAL(const T &)>
+class FunctionValidate
+{
+    public:
+        /// Checks whether a value is valid. See Policies.ipp.
+        bool operator()(const T &value) const
+        {
+            return VAL(value);
+        }
+};
+
+/// An equal policy that calls a given predicate.
+/// @tparam EQ The predicate that checks whether two given values are equal.
+template<typename T, bool EQ(const T &, const T &)>
+class FunctionEqual
+{
+    public:
+        /// Checks whether two values are equal. See Policies.ipp.
+        bool operator()(const T &a, const T &b) const
+        {
+            return EQ(a, b);
+        }
+};
+
+/// A validate policy that accepts every value.
+template<typename T>
+class AnyValidate
+{
+    public:
+        /// Checks whether a value is valid. See Policies.ipp.
+        constexpr bool operator()(const T &) const
+        {
+            return true;
+        }
+};
+
+/// An equal policy that compares values with operator==.
+template<typename T>
+class ExactEqual
+{
+    public:
+        /// Checks whether two values are equal. See Policies.ipp.
+        constexpr bool operator()(const T &a, const T &b) const
+        {
+            return a == b;
+        }
+};
+
+/// A validate policy that accepts printable ASCII characters, except space.
+class PrintableCharValidate
+{
+    public:
+        /// Checks whether a value is valid. See Policies.ipp.
+        constexpr bool operator()(const char &c) const
+        {
+            return '!' <= c && c <= '~';
+        }
+};
+
+/// A validate policy that accepts non-empty words of printable ASCII
+/// characters, except space.
+class PrintableWordValidate
+{
+    public:
+        /// Checks whether a value is valid. See Policies.ipp.
+        bool operator()(const string &word) const
+        {
+            if (word.empty())
+            {
+                return false;
+            }
+
+            for (char c : word)
+            {
+                if (!PrintableCharValidate()(c))
+                {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+};
+
+/// A validate policy that accepts finite floating-point numbers.
+template<typename T>
+class FiniteValidate
+{
+    public:
+        /// Checks whether a value is valid. See Policies.ipp.
+        bool operator()(const T &value) const
+        {
+            return std::isfinite(value);
+        }
+};
+
+/// An equal policy that accepts floating-point numbers that are within an
+/// absolute tolerance or within a relative tolerance of each other. The
+/// relative tolerance is relative to the first number, i.e., the correct one.
+template<typename T>
+class ToleranceEqual
+{
+    private:
+        T mAbsolute; ///< The absolute tolerance.
+        T mLower;    ///< The lower ratio for the relative tolerance.
+        T mUpper;    ///< The upper ratio for the relative tolerance.
+
+    public:
+        /// Constructs the policy with given tolerances. The defaults are an
+        /// error of 0.00001 (due to six digit printing of floats) and of 1%.
+        /// @param absolute The absolute tolerance.
+        /// @param relative The relative tolerance, e.g., 0.01 for 1%.
+        constexpr ToleranceEqual(T absolute = T(0.00001L), T relative = T(0.01L)) :
+              mAbsolute(absolute), mLower(1 - relative), mUpper(1 + relative)
+        {
+        }
+
+        /// The absolute tolerance.
+        constexpr T absolute() const
+        {
+            return mAbsolute;
+        }
+
+        /// The relative tolerance, up to the rounding of the ratios.
+        constexpr T relative() const
+        {
+            return (mUpper - mLower) / 2;
+        }
+
+        /// Checks whether two values are equal. See Policies.ipp.
+        constexpr bool operator()(const T &a, const T &b) const
+        {
+            if (a - b <= mAbsolute && b - a <= mAbsolute)
+            {
+                return true;
+            }
+
+            if (a >= T(0))
+            {
+                return a * mLower <= b && b <= a * mUpper;
+            }
+            else
+            {
+                return a * mUpper <= b && b <= a * mLower;
+            }
+        }
+};
+
+/// The suffix of the tolerance files (see ColumnToleranceEqual::load) next to
+/// <correct_output_file>.
+constexpr const char *ToleranceSuffix = ".tolerance";
+
+/// An equal policy that compares floating-point numbers as ToleranceEqual does,
+/// with tolerances per column. The tolerances are held in a flat array, shared
+/// by the copies of the policy, which is indexed by the column of the tokens
+/// (see Token::column) modulo the length of the array, so that the tolerances
+/// of a pair are looked up without a branch.
+///
+/// The columns are the values of a line in <correct_output_file>, counted
+/// from 0, whatever whitespace separates them. If a line has more values than
+/// there are columns, the columns repeat.
+template<typename T>
+class ColumnToleranceEqual
+{
+    private:
+        shared_ptr<const vector<ToleranceEqual<T>>> mTable; ///< Owns mColumns.
+        const ToleranceEqual<T> *mColumns; ///< The tolerances by column.
+        size_t mPeriod;                    ///< The length of the array.
+
+        /// Sets the tolerances of the columns.
+        void setColumns(const vector<ToleranceEqual<T>> &columns)
+        {
+            auto table = std::make_shared<vector<ToleranceEqual<T>>>(columns);
+
+            mTable = table;
+            mColumns = table->data();
+            mPeriod = table->size();
+        }
+
+    public:
+        /// Constructs the policy with the same tolerances for all columns.
+        /// @param uniform The tolerances.
+        ColumnToleranceEqual(const ToleranceEqual<T> &uniform = ToleranceEqual<T>()) :
+              mTable(), mColumns(nullptr), mPeriod(0)
+        {
+            setColumns({uniform});
+        }
+
+        /// Reads the tolerances of the columns from a tolerance file. Each line
+        /// of the file, except those that are empty or comments that start with
+        /// '#', gives the tolerances of the next column:
+        ///     <absolute_tolerance> <relative_tolerance>
+        /// e.g., "0.00001 0.01". Thus, a file with a single line gives the same
+        /// tolerances to all values.
+        /// @param input The contents of the file.
+        /// @return Whether the file is valid. If not, the tolerances are kept.
+        bool load(istream &input)
+        {
+            vector<ToleranceEqual<T>> columns;
+            string line;
+
+            while (std::getline(input, line))
+            {
+                string content = line.substr(0, line.find('#'));
+
+                if (content.find_first_not_of(" \t\r") == string::npos)
+                {
+                    continue;
+                }
+
+                std::istringstream fields(content);
+                T absolute;
+                T relative;
+                string rest;
+
+                if (!(fields >> absolute >> relative) || (fields >> rest) ||
+                    !std::isfinite(absolute) || !std::isfinite(relative) ||
+                    absolute < 0 || relative < 0)
+                {
+                    return false;
+                }
+
+                columns.emplace_back(absolute, relative);
+            }
+
+            if (columns.empty())
+            {
+                return false;
+            }
+
+            setColumns(columns);
+            return true;
+        }
+
+        /// The lowest absolute tolerance of the columns, with which a pair that
+        /// is certainly equal is equal in any column.
+        T absolute() const
+        {
+            T result = mColumns[0].absolute();
+
+            for (size_t i = 1; i < mPeriod; i++)
+            {
+                result = std::min(result, mColumns[i].absolute());
+            }
+
+            return result;
+        }
+
+        /// The lowest relative tolerance of the columns. See absolute().
+        T relative() const
+        {
+            T result = mColumns[0].relative();
+
+            for (size_t i = 1; i < mPeriod; i++)
+            {
+                result = std::min(result, mColumns[i].relative());
+            }
+
+            return result;
+        }
+
+        /// Checks whether two values are equal with the tolerances of the first
+        /// column. See Policies.ipp.
+        bool operator()(const T &a, const T &b) const
+        {
+            return mColumns[0](a, b);
+        }
+
+        /// Checks whether two values in a column are equal with the tolerances
+        /// of the column. See Policies.ipp.
+        /// @param column The column of the values, as in Token::column.
+        bool operator()(const T &a, const T &b, uint64_t column) const
+        {
+            return mColumns[column % mPeriod](a, b);
+        }
+};
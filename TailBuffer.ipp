@@ -0,0 +1,126 @@
+// Author: Hakan Yıldız
+// Shared under MIT License. See the file LICENSE for more info.
+
+/// @file TailBuffer.ipp
+/// Implements the TailBuffer class.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using std::logic_error;
+using std::size_t;
+using std::string;
+using std::uint64_t;
+using std::vector;
+
+/// A ring buffer that keeps only the tail of the text appended to it: at most
+/// a given number of lines, and at most a given number of bytes. The memory in
+/// use is bounded by these limits, regardless of the amount of text appended.
+class TailBuffer
+{
+    private:
+        vector<char> mBytes;          ///< The ring of the last bytes.
+        vector<uint64_t> mLineStarts; ///< The ring of offsets after newlines.
+        uint64_t mSize;               ///< The number of bytes so far.
+        uint64_t mNewlines;           ///< The number of newlines so far.
+        uint64_t mSkipped;            ///< The offset before which nothing is kept.
+
+        /// The offset of the first byte that is kept.
+        uint64_t begin() const
+        {
+            uint64_t begin = std::max(mSkipped,
+                                      mSize > mBytes.size() ? mSize - mBytes.size() : 0);
+
+            if (mNewlines >= mLineStarts.size())
+            {
+                // Start after the newline that precedes the lines to keep.
+                uint64_t newline = mNewlines - mLineStarts.size() + 1;
+
+                begin = std::max(begin, mLineStarts[newline % mLineStarts.size()]);
+            }
+
+            return begin;
+        }
+
+    public:
+        /// Constructs an empty buffer.
+        /// @param maxLines The number of lines to keep, including the line that
+        ///                 is not terminated yet. Must be positive.
+        /// @param maxBytes The number of bytes to keep. Must be positive.
+        TailBuffer(size_t maxLines, size_t maxBytes) :
+              mBytes(maxBytes), mLineStarts(maxLines), mSize(0), mNewlines(0),
+              mSkipped(0)
+        {
+            if (maxLines == 0 || maxBytes == 0)
+            {
+                throw logic_error("Cannot create an empty tail buffer.");
+            }
+        }
+
+        /// Appends a character.
+        void append(char c)
+        {
+            mBytes[mSize % mBytes.size()] = c;
+            mSize++;
+
+            if (c == '\n')
+            {
+                mNewlines++;
+                mLineStarts[mNewlines % mLineStarts.size()] = mSize;
+            }
+        }
+
+        /// Appends a range of characters.
+        /// @param data  The first character.
+        /// @param count The number of characters.
+        void append(const char *data, size_t count)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                append(data[i]);
+            }
+        }
+
+        /// Accounts for text that follows the text so far, without keeping
+        /// either of them.
+        /// @param count The number of bytes in the text.
+        void skip(uint64_t count)
+        {
+            mSize += count;
+            mSkipped = mSize;
+        }
+
+        /// Returns the kept text. If some text was not kept, the returned text
+        /// is preceded by the given marker, and a newline if the kept text
+        /// starts a line.
+        /// @param marker The marker for the text that is not kept.
+        string str(const string &marker) const
+        {
+            uint64_t first = begin();
+            string result;
+
+            if (first > 0)
+            {
+                result += marker;
+
+                if (mNewlines > 0 && std::count(mLineStarts.begin(),
+                                                mLineStarts.end(), first) > 0)
+                {
+                    result += '\n';
+                }
+            }
+
+            for (uint64_t i = first; i < mSize; i++)
+            {
+                result += mBytes[i % mBytes.size()];
+            }
+
+            return result;
+        }
+};
@@ -0,0 +1,442 @@
+// Author: Hakan Yıldız
+// Shared under MIT License. See the file LICENSE for more info.
+
+/// @file TokenPairs.ipp
+/// Implements the readers with which diff_checker_base.ipp reads the tokens of
+/// <claimed_output_file> and <correct_output_file> in pairs, and tells whether
+/// the tokens of each pair are equal:
+/// - SequentialTokenPairs compares each pair with the equal policy.
+/// - BatchedTokenPairs reads the pairs in batches whose values are compared
+///   with ToleranceEqual as doubles, in a vectorized kernel, which only accepts
+///   the pairs that are certainly equal under the long double comparison. With
+///   ColumnToleranceEqual, the kernel takes the lowest tolerances of all
+///   columns, so that it still accepts only such pairs. The
+///   first other pair of a batch is found by a mask scan, and compared with
+///   the equal policy.
+/// A reader provides:
+///     bool next();
+///         Reads the next pair, and returns whether its tokens are equal.
+///     const TokenType & claimedToken() const;
+///     const TokenType & correctToken() const;
+///         The tokens of the pair, which stay valid until next() is called.
+///     TokenType nextClaimed();
+///         Reads the next claimed token, once the comparison is over.
+
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+#include "Policies.ipp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #include <immintrin.h>
+    #define TOKEN_PAIRS_X86
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    #include <arm_neon.h>
+    #define TOKEN_PAIRS_NEON
+#endif
+
+using std::size_t;
+using std::uint64_t;
+
+/// The number of pairs that BatchedTokenPairs reads at once.
+constexpr size_t TokenPairsBatchSize = 256;
+
+/// The relative error that the double comparison of tolerancePrefix() allows
+/// for, which is far more than the rounding to double and in the long double
+/// comparison.
+constexpr double ToleranceMargin = 0x1p-40;
+
+/// The tolerances with which tolerancePrefix() compares values.
+struct ToleranceBounds
+{
+    double absolute; ///< The absolute tolerance.
+    double relative; ///< The relative tolerance.
+};
+
+/// The scalar implementation of tolerancePrefix(), which starts at the given
+/// index and also finishes the vectorized implementations.
+inline size_t tolerancePrefixScalar(const double *correct, const double *claimed,
+                                    size_t n, size_t i, ToleranceBounds bounds)
+{
+    for (; i < n; i++)
+    {
+        double a = correct[i];
+        double b = claimed[i];
+        double difference = std::fabs(a - b);
+        double sum = std::fabs(a) + std::fabs(b);
+        double bound = std::max(bounds.absolute, std::fabs(a) * bounds.relative);
+
+        // Comparisons with NaN are false, so NaN marks an uncertain pair.
+        if (!(difference + ToleranceMargin * (sum + bound) + DBL_MIN <= bound))
+        {
+            break;
+        }
+    }
+
+    return i;
+}
+
+#ifdef TOKEN_PAIRS_X86
+
+/// The SSE2 implementation of tolerancePrefix(), using 2-value blocks.
+__attribute__((target("sse2")))
+inline size_t tolerancePrefixSse2(const double *correct, const double *claimed,
+                                  size_t n, ToleranceBounds bounds)
+{
+    const __m128d magnitude = _mm_castsi128_pd(_mm_set1_epi64x(0x7FFFFFFFFFFFFFFFLL));
+    const __m128d absolute = _mm_set1_pd(bounds.absolute);
+    const __m128d relative = _mm_set1_pd(bounds.relative);
+    const __m128d margin = _mm_set1_pd(ToleranceMargin);
+    const __m128d tiny = _mm_set1_pd(DBL_MIN);
+
+    size_t i = 0;
+
+    for (; i + 2 <= n; i += 2)
+    {
+        __m128d a = _mm_loadu_pd(correct + i);
+        __m128d b = _mm_loadu_pd(claimed + i);
+        __m128d absA = _mm_and_pd(a, magnitude);
+        __m128d difference = _mm_and_pd(_mm_sub_pd(a, b), magnitude);
+        __m128d sum = _mm_add_pd(absA, _mm_and_pd(b, magnitude));
+        __m128d bound = _mm_max_pd(_mm_mul_pd(absA, relative), absolute);
+        __m128d error = _mm_add_pd(_mm_mul_pd(margin, _mm_add_pd(sum, bound)), tiny);
+        int ok = _mm_movemask_pd(_mm_cmple_pd(_mm_add_pd(difference, error), bound));
+
+        if (ok != 0x3)
+        {
+            return i + static_cast<size_t>(__builtin_ctz(~ok));
+        }
+    }
+
+    return tolerancePrefixScalar(correct, claimed, n, i, bounds);
+}
+
+/// The AVX2 implementation of tolerancePrefix(), using 4-value blocks.
+__attribute__((target("avx2")))
+inline size_t tolerancePrefixAvx2(const double *correct, const double *claimed,
+                                  size_t n, ToleranceBounds bounds)
+{
+    const __m256d magnitude = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7FFFFFFFFFFFFFFFLL));
+    const __m256d absolute = _mm256_set1_pd(bounds.absolute);
+    const __m256d relative = _mm256_set1_pd(bounds.relative);
+    const __m256d margin = _mm256_set1_pd(ToleranceMargin);
+    const __m256d tiny = _mm256_set1_pd(DBL_MIN);
+
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256d a = _mm256_loadu_pd(correct + i);
+        __m256d b = _mm256_loadu_pd(claimed + i);
+        __m256d absA = _mm256_and_pd(a, magnitude);
+        __m256d difference = _mm256_and_pd(_mm256_sub_pd(a, b), magnitude);
+        __m256d sum = _mm256_add_pd(absA, _mm256_and_pd(b, magnitude));
+        __m256d bound = _mm256_max_pd(_mm256_mul_pd(absA, relative), absolute);
+        __m256d error = _mm256_add_pd(_mm256_mul_pd(margin, _mm256_add_pd(sum, bound)), tiny);
+        int ok = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_add_pd(difference, error), bound,
+                                                  _CMP_LE_OQ));
+
+        if (ok != 0xF)
+        {
+            return i + static_cast<size_t>(__builtin_ctz(~ok));
+        }
+    }
+
+    return tolerancePrefixScalar(correct, claimed, n, i, bounds);
+}
+
+#endif
+
+#ifdef TOKEN_PAIRS_NEON
+
+/// The NEON implementation of tolerancePrefix(), using 2-value blocks.
+inline size_t tolerancePrefixNeon(const double *correct, const double *claimed,
+                                  size_t n, ToleranceBounds bounds)
+{
+    const float64x2_t absolute = vdupq_n_f64(bounds.absolute);
+    const float64x2_t relative = vdupq_n_f64(bounds.relative);
+    const float64x2_t margin = vdupq_n_f64(ToleranceMargin);
+    const float64x2_t tiny = vdupq_n_f64(DBL_MIN);
+
+    size_t i = 0;
+
+    for (; i + 2 <= n; i += 2)
+    {
+        float64x2_t a = vld1q_f64(correct + i);
+        float64x2_t b = vld1q_f64(claimed + i);
+        float64x2_t absA = vabsq_f64(a);
+        float64x2_t difference = vabdq_f64(a, b);
+        float64x2_t sum = vaddq_f64(absA, vabsq_f64(b));
+        float64x2_t bound = vmaxq_f64(vmulq_f64(absA, relative), absolute);
+        float64x2_t error = vaddq_f64(vmulq_f64(margin, vaddq_f64(sum, bound)), tiny);
+        uint64x2_t ok = vcleq_f64(vaddq_f64(difference, error), bound);
+
+        if (vgetq_lane_u64(ok, 0) == 0)
+        {
+            return i;
+        }
+        else if (vgetq_lane_u64(ok, 1) == 0)
+        {
+            return i + 1;
+        }
+    }
+
+    return tolerancePrefixScalar(correct, claimed, n, i, bounds);
+}
+
+#endif
+
+/// Finds the longest prefix of pairs of values that are certainly equal under
+/// ToleranceEqual<long double> with given tolerances, i.e., whose difference
+/// is within the tolerance by a margin, which covers the rounding to double.
+/// NaN marks a pair that is not certainly equal.
+/// @param correct The correct values.
+/// @param claimed The claimed values.
+/// @param n The number of pairs.
+/// @param bounds The tolerances.
+/// @return The length of the prefix.
+inline size_t tolerancePrefix(const double *correct, const double *claimed,
+                              size_t n, ToleranceBounds bounds)
+{
+#if defined(TOKEN_PAIRS_X86)
+    static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+    static const bool hasSse2 = __builtin_cpu_supports("sse2");
+
+    if (hasAvx2)
+    {
+        return tolerancePrefixAvx2(correct, claimed, n, bounds);
+    }
+    else if (hasSse2)
+    {
+        return tolerancePrefixSse2(correct, claimed, n, bounds);
+    }
+#elif defined(TOKEN_PAIRS_NEON)
+    return tolerancePrefixNeon(correct, claimed, n, bounds);
+#endif
+
+    return tolerancePrefixScalar(correct, claimed, n, 0, bounds);
+}
+
+/// Reads token pairs one by one. See the documentation of TokenPairs.ipp.
+/// @tparam Tokenizer The tokenizer of <claimed_output_file>.
+/// @tparam CorrectTokenizer The tokenizer of <correct_output_file>.
+template<typename Tokenizer, typename CorrectTokenizer>
+class SequentialTokenPairs
+{
+    public:
+        /// The Token type read.
+        typedef typename Tokenizer::TokenType TokenType;
+
+    private:
+        Tokenizer & mClaimed;                        ///< The claimed tokenizer.
+        CorrectTokenizer & mCorrect;                 ///< The correct tokenizer.
+        const typename Tokenizer::EqualType & mEqual; ///< The equal policy.
+        TokenType mClaimedToken;                     ///< The claimed token.
+        TokenType mCorrectToken;                     ///< The correct token.
+
+    public:
+        /// Constructs the reader on given tokenizers.
+        /// @param claimed The claimed tokenizer.
+        /// @param correct The correct tokenizer.
+        /// @param equal The equal policy to compare the tokens with.
+        SequentialTokenPairs(Tokenizer &claimed, CorrectTokenizer &correct,
+                             const typename Tokenizer::EqualType &equal) :
+              mClaimed(claimed), mCorrect(correct), mEqual(equal),
+              mClaimedToken(), mCorrectToken()
+        {
+        }
+
+        /// Reads the next pair. See the documentation of TokenPairs.ipp.
+        bool next()
+        {
+            mClaimedToken = mClaimed.next();
+            mCorrectToken = mCorrect.next();
+            return mCorrectToken.isEqual(mClaimedToken, mEqual);
+        }
+
+        /// The claimed token of the pair. See the documentation of TokenPairs.ipp.
+        const TokenType & claimedToken() const
+        {
+            return mClaimedToken;
+        }
+
+        /// The correct token of the pair. See the documentation of TokenPairs.ipp.
+        const TokenType & correctToken() const
+        {
+            return mCorrectToken;
+        }
+
+        /// Reads the next claimed token. See the documentation of TokenPairs.ipp.
+        TokenType nextClaimed()
+        {
+            return mClaimed.next();
+        }
+};
+
+/// Reads token pairs in batches, to compare their values with a vectorized
+/// kernel. See the documentation of TokenPairs.ipp.
+/// @tparam Tokenizer The tokenizer of <claimed_output_file>, whose equal
+///                   policy is ToleranceEqual or ColumnToleranceEqual on a
+///                   floating-point type.
+/// @tparam CorrectTokenizer The tokenizer of <correct_output_file>.
+template<typename Tokenizer, typename CorrectTokenizer>
+class BatchedTokenPairs
+{
+    public:
+        /// The Token type read.
+        typedef typename Tokenizer::TokenType TokenType;
+
+    private:
+        typedef typename Tokenizer::TokenKind TokenKind;
+        typedef typename Tokenizer::ValueType ValueType;
+
+        Tokenizer & mClaimed;                        ///< The claimed tokenizer.
+        CorrectTokenizer & mCorrect;                 ///< The correct tokenizer.
+        const typename Tokenizer::EqualType & mEqual; ///< The equal policy.
+        ToleranceBounds mBounds;                     ///< The tolerances of mEqual.
+
+        TokenType mClaimedTokens[TokenPairsBatchSize]; ///< The claimed tokens.
+        TokenType mCorrectTokens[TokenPairsBatchSize]; ///< The correct tokens.
+        double mClaimedValues[TokenPairsBatchSize];    ///< The claimed values.
+        double mCorrectValues[TokenPairsBatchSize];    ///< The correct values.
+        size_t mCount;   ///< The number of pairs in the batch.
+        size_t mIndex;   ///< The index of the next pair in the batch.
+        size_t mPair;    ///< The index of the pair read by next().
+        size_t mCertain; ///< The end of the certainly equal pairs from mIndex.
+
+        /// Converts a value to double, or to NaN if it is out of range.
+        static double toDouble(const ValueType &value)
+        {
+            if (!(std::fabs(value) <= std::numeric_limits<double>::max()))
+            {
+                return std::numeric_limits<double>::quiet_NaN();
+            }
+
+            return static_cast<double>(value);
+        }
+
+        /// Finds the end of the certainly equal pairs from a given index.
+        size_t certainEnd(size_t from) const
+        {
+            return from + tolerancePrefix(mCorrectValues + from, mClaimedValues + from,
+                                          mCount - from, mBounds);
+        }
+
+        /// Reads the next batch of pairs. The batch ends early with a pair in
+        /// which a token is the end of the file or invalid, after which the
+        /// tokenizers are not read anymore.
+        void fill()
+        {
+            mCount = 0;
+            mIndex = 0;
+
+            while (mCount < TokenPairsBatchSize)
+            {
+                TokenType &claimedToken = mClaimedTokens[mCount];
+                TokenType &correctToken = mCorrectTokens[mCount];
+
+                claimedToken = mClaimed.next();
+                correctToken = mCorrect.next();
+
+                // Pairs that are not values are certainly equal if their kinds
+                // are, and are left to the equal policy otherwise.
+                if (claimedToken.kind() == TokenKind::Valid &&
+                    correctToken.kind() == TokenKind::Valid)
+                {
+                    mClaimedValues[mCount] = toDouble(claimedToken.value());
+                    mCorrectValues[mCount] = toDouble(correctToken.value());
+                }
+                else if (claimedToken.kind() == correctToken.kind() &&
+                         claimedToken.kind() != TokenKind::Invalid)
+                {
+                    mClaimedValues[mCount] = 0;
+                    mCorrectValues[mCount] = 0;
+                }
+                else
+                {
+                    mClaimedValues[mCount] = std::numeric_limits<double>::quiet_NaN();
+                    mCorrectValues[mCount] = std::numeric_limits<double>::quiet_NaN();
+                }
+
+                mCount++;
+
+                if (claimedToken.kind() == TokenKind::EndOfFile ||
+                    claimedToken.kind() == TokenKind::Invalid ||
+                    correctToken.kind() == TokenKind::EndOfFile ||
+                    correctToken.kind() == TokenKind::Invalid)
+                {
+                    break;
+                }
+            }
+
+            mCertain = certainEnd(0);
+        }
+
+    public:
+        /// Constructs the reader on given tokenizers.
+        /// @param claimed The claimed tokenizer.
+        /// @param correct The correct tokenizer.
+        /// @param equal The equal policy to compare the tokens with.
+        BatchedTokenPairs(Tokenizer &claimed, CorrectTokenizer &correct,
+                          const typename Tokenizer::EqualType &equal) :
+              mClaimed(claimed), mCorrect(correct), mEqual(equal),
+              mBounds{static_cast<double>(equal.absolute()),
+                      static_cast<double>(equal.relative())},
+              mClaimedTokens(), mCorrectTokens(), mClaimedValues(),
+              mCorrectValues(), mCount(0), mIndex(0), mPair(0), mCertain(0)
+        {
+        }
+
+        /// Reads the next pair. See the documentation of TokenPairs.ipp.
+        bool next()
+        {
+            if (mIndex == mCount)
+            {
+                fill();
+            }
+
+            mPair = mIndex++;
+
+            if (mPair < mCertain)
+            {
+                return true;
+            }
+
+            mCertain = certainEnd(mPair + 1);
+            return mCorrectTokens[mPair].isEqual(mClaimedTokens[mPair], mEqual);
+        }
+
+        /// The claimed token of the pair. See the documentation of TokenPairs.ipp.
+        const TokenType & claimedToken() const
+        {
+            return mClaimedTokens[mPair];
+        }
+
+        /// The correct token of the pair. See the documentation of TokenPairs.ipp.
+        const TokenType & correctToken() const
+        {
+            return mCorrectTokens[mPair];
+        }
+
+        /// Reads the next claimed token. See the documentation of TokenPairs.ipp.
+        TokenType nextClaimed()
+        {
+            return (mIndex < mCount) ? mClaimedTokens[mIndex++] : mClaimed.next();
+        }
+};
+
+/// Whether the tokens of a tokenizer can be compared by BatchedTokenPairs.
+template<typename Tokenizer>
+constexpr bool SupportsBatchedTokenPairs =
+    std::is_floating_point_v<typename Tokenizer::ValueType> &&
+    (std::is_same_v<typename Tokenizer::EqualType,
+                    ToleranceEqual<typename Tokenizer::ValueType>> ||
+     std::is_same_v<typename Tokenizer::EqualType,
+                    ColumnToleranceEqual<typename Tokenizer::ValueType>>);
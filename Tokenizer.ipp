@@ -6,21 +6,78 @@
 
 #pragma once
 
+#include <charconv>
+#include <cstddef>
 #include <cstdint>
 #include <stdexcept>
 #include <sstream>
+#include <type_traits>
+#include <utility>
+
+#include "CheckerStats.ipp"
+#include "Input.ipp"
+#include "Parse.ipp"
+#include "Policies.ipp"
 
 using std::logic_error;
-using std::istream;
 using std::runtime_error;
+using std::size_t;
 using std::string;
 using std::stringstream;
 using std::uint64_t;
 
+/// Appends a value to a buffer, formatted as operator<< would format it on a
+/// default-constructed stream. Characters and arithmetic values are formatted
+/// into a fixed-size array with std::to_chars, without allocating, and values
+/// with an appendTo(buffer) member (e.g., Integer) append themselves.
+/// @param buffer The buffer to append to. Any type with a member
+///               append(const char *data, size_t count), e.g., std::string.
+/// @param value  The value to append.
+template<typename Buffer, typename T>
+void appendFormatted(Buffer &buffer, const T &value)
+{
+    if constexpr (std::is_same_v<T, char>)
+    {
+        buffer.append(&value, 1);
+    }
+    else if constexpr (std::is_same_v<T, string>)
+    {
+        buffer.append(value.data(), value.size());
+    }
+    else if constexpr (std::is_floating_point_v<T>)
+    {
+        // The default stream precision is 6, as in "%g", i.e., at most
+        // "-d.ddddde+dddd" (a few characters more for long double).
+        char text[32];
+        auto result = std::to_chars(text, text + sizeof(text), value,
+                                    std::chars_format::general, 6);
+
+        buffer.append(text, static_cast<size_t>(result.ptr - text));
+    }
+    else if constexpr (std::is_integral_v<T> && !std::is_same_v<T, bool>)
+    {
+        char text[24];
+        auto result = std::to_chars(text, text + sizeof(text), value);
+
+        buffer.append(text, static_cast<size_t>(result.ptr - text));
+    }
+    else if constexpr (requires { value.appendTo(buffer); })
+    {
+        value.appendTo(buffer);
+    }
+    else
+    {
+        stringstream ss;
+        ss << value;
+        string text = ss.str();
+        buffer.append(text.data(), text.size());
+    }
+}
+
 /// Represents a token read by a Tokenizer.
 /// @tparam T Base character type for the Token.
-/// @tparam EQ Equality predicate for the base characters.
-template<typename T, bool EQ(const T &, const T &)>
+/// @tparam Equal Equal policy for the base characters (see Policies.ipp).
+template<typename T, typename Equal>
 class Token 
 {
     public:
@@ -41,14 +98,22 @@ class Token
         T mValue;   ///< The underlying field for value().
         Pos mLine;  ///< The underlying field for line().
         Pos mToken; ///< The underlying field for token().
+        Pos mColumn; ///< The underlying field for column().
 
     public:
+        /// Constructs an end-of-file token at line and token 0, e.g., to be
+        /// assigned later.
+        Token() :
+              mKind(Kind::EndOfFile), mValue(), mLine(0), mToken(0), mColumn(0)
+        {
+        }
+
         /// Constructs a token whose kind is different than Kind::Valid.
         /// @param kind The kind of the token. Must not be Kind::Valid.
         /// @param line The line number of the token.
         /// @param token The token number (within the line) of the token.
         Token(Kind kind, Pos line, Pos token) :
-              mKind(kind), mValue(), mLine(line), mToken(token)
+              mKind(kind), mValue(), mLine(line), mToken(token), mColumn(0)
         {
             if (mKind == Kind::Valid)
             {
@@ -63,8 +128,11 @@ class Token
         /// @param value The value from which the token is constructed.
         /// @param line The line number of the token.
         /// @param token The token number (within the line) of the token.
-        Token(T value, Pos line, Pos token) :
-              mKind(Kind::Valid), mValue(value), mLine(line), mToken(token)
+        /// @param column The number of valid tokens before the token within
+        ///               the line.
+        Token(T value, Pos line, Pos token, Pos column) :
+              mKind(Kind::Valid), mValue(std::move(value)), mLine(line),
+              mToken(token), mColumn(column)
         {
         }
 
@@ -102,16 +170,24 @@ class Token
             return mToken;
         }
 
+        /// The column of this token, i.e., the number of valid tokens before it
+        /// within its line, if kind() is Kind::Valid. Unlike token(), it does
+        /// not depend on the whitespace between the values.
+        const Pos & column() const
+        {
+            return mColumn;
+        }
+
         /// Returns a long string for the token, which is always printable.
         string lstr() const
         {
-            stringstream ss;
+            string result(1, '\'');
 
             switch (mKind)
             {
                 case Kind::Valid:
-                    ss << mValue;
-                    return "'" + ss.str() + "'";
+                    appendFormatted(result, mValue);
+                    return result + "'";
                 case Kind::Newline:
                     return "<newline>";
                 case Kind::Space:
@@ -128,21 +204,34 @@ class Token
         /// Returns a short string for the token.
         string sstr() const
         {
-            stringstream ss;
+            string result;
+            appendTo(result);
+            return result;
+        }
 
+        /// Appends the short string for the token (see sstr()) to a buffer,
+        /// without allocating, as long as the buffer does not.
+        /// @param buffer The buffer to append to. See appendFormatted().
+        template<typename Buffer>
+        void appendTo(Buffer &buffer) const
+        {
             switch (mKind)
             {
                 case Kind::Valid:
-                    ss << mValue;
-                    return ss.str();
+                    appendFormatted(buffer, mValue);
+                    return;
                 case Kind::Newline:
-                    return "\n";
+                    buffer.append("\n", 1);
+                    return;
                 case Kind::Space:
-                    return " ";
+                    buffer.append(" ", 1);
+                    return;
                 case Kind::EndOfFile:
-                    return "<end>";
+                    buffer.append("<end>", 5);
+                    return;
                 case Kind::Invalid:
-                    return "<invalid-format>";
+                    buffer.append("<invalid-format>", 16);
+                    return;
                 default:
                     throw new logic_error("Unrecognized kind.");
             }
@@ -150,7 +239,8 @@ class Token
 
         /// Checks if this token is equal to another.
         /// @param t The token to check against.
-        bool isEqual(const Token &t) const
+        /// @param equal The equal policy to compare the values with.
+        bool isEqual(const Token &t, const Equal &equal = Equal()) const
         {
             if (mKind != t.mKind)
             {
@@ -158,7 +248,12 @@ class Token
             }
             else if (mKind == Kind::Valid)
             {
-                if (EQ(mValue, t.mValue))
+                // A policy that takes the column of the tokens gets it.
+                if constexpr (requires { equal(mValue, t.mValue, mColumn); })
+                {
+                    return equal(mValue, t.mValue, mColumn);
+                }
+                else if (equal(mValue, t.mValue))
                 {
                     return true;
                 }
@@ -174,39 +269,55 @@ class Token
         }
 };
 
-/// A class to read tokens from an std::istream. The main functionality is
+/// A class to read tokens from an input backend (see Input.ipp). The main functionality is
 /// skipping the following whitespace characters during tokenization:
 /// - A space that precedes a newline.
 /// - A space that precedes the end of the file.
 /// - A newline that precedes the end of the file.
 /// Also, the class can check for validity of the tokens (e.g., whether they are
-/// in ASCII range) with a predicate supplied as a template parameter. The
+/// in ASCII range) with a validate policy supplied as a template parameter. The
 /// tokenization stops upon an invalid symbol, returning an invalid token, and
 /// invalidating the tokenizer.
 /// @tparam The base character type for the Token objects produced.
-/// @tparam The predicate that checks whether a given character is valid.
-/// @tparam The equality predicate for the Token objects produced.
+/// @tparam The validate policy for the values (see Policies.ipp).
+/// @tparam The equal policy for the Token objects produced (see Policies.ipp).
+/// @tparam The input backend, e.g., StreamInput or ByteInput.
+/// @tparam The parse policy with which ByteInput reads the values.
 template<typename T,
-         bool VAL(const T &),
-         bool EQ(const T &, const T &)>
-class Tokenizer
+         typename Validate,
+         typename Equal,
+         typename Input = StreamInput,
+         typename Parse = DefaultParse<T>>
+class BasicTokenizer
 {
     public:
+        /// The value type of the Token objects produced.
+        typedef T ValueType;
         /// The Token type instantiated in this class.
-        typedef Token<T, EQ> TokenType;
+        typedef Token<T, Equal> TokenType;
         /// The Token::Kind type instantiated in this class.
         typedef TokenType::Kind TokenKind;
         /// The Token::Pos type instantiated in this class.
         typedef TokenType::Pos TokenPos;
+        /// The input backend type instantiated in this class.
+        typedef Input InputType;
+        /// The validate policy type instantiated in this class.
+        typedef Validate ValidateType;
+        /// The equal policy type instantiated in this class.
+        typedef Equal EqualType;
 
     private:
-        istream & mInput; ///< The internal istream, provided upon construction.
-        bool mIsValid;    ///< The underlying field for isValid().
-        TokenPos mLine;   ///< The line number for the next token.
-        TokenPos mToken;  ///< The token number for the next token.
-
-        /// Consumes an expected (peeked) character from the internal istream.
-        void consume(istream::int_type c)
+        Input & mInput;     ///< The internal input, provided upon construction.
+        Validate mValidate; ///< The validate policy for the values.
+        Parse mParse;       ///< The parse policy for the values.
+        bool mIsValid;      ///< The underlying field for isValid().
+        TokenPos mLine;     ///< The line number for the next token.
+        TokenPos mToken;    ///< The token number for the next token.
+        TokenPos mColumn;   ///< The column for the next valid token.
+        [[no_unique_address]] TokenizerStats<> mStats; ///< See CheckerStats.ipp.
+
+        /// Consumes an expected (peeked) character from the internal input.
+        void consume(int c)
         {
             if (mInput.get() != c)
             {
@@ -216,9 +327,12 @@ class Tokenizer
         }
 
     public:
-        /// Constructs a tokenizer on a given istream.
-        Tokenizer(istream & input) :
-              mInput(input), mIsValid(true), mLine(1), mToken(1)
+        /// Constructs a tokenizer on a given input backend.
+        /// @param input The input backend.
+        /// @param validate The validate policy for the values.
+        BasicTokenizer(Input & input, const Validate &validate = Validate()) :
+              mInput(input), mValidate(validate), mParse(), mIsValid(true),
+              mLine(1), mToken(1), mColumn(0), mStats()
         {
         }
 
@@ -228,8 +342,44 @@ class Tokenizer
             return mIsValid;
         }
 
+        /// Skips complete lines that the caller has tokenized by other means.
+        /// Supported only by the input backends that implement skip().
+        /// @param count The number of bytes to skip, which must end right after
+        ///              a newline that does not precede the end of the input.
+        /// @param lines The number of newlines within the skipped bytes.
+        void skipLines(size_t count, TokenPos lines)
+        {
+            if (mToken != 1)
+            {
+                throw logic_error("Cannot skip lines from the middle of a line.");
+            }
+
+            mInput.skip(count);
+            mLine += lines;
+        }
+
         /// Produces the next token.
         TokenType next()
+        {
+            if constexpr (CheckerStatsEnabled)
+            {
+                mStats.startParse();
+
+                TokenType t = read();
+
+                mStats.stopParse();
+                mStats.count(t.kind());
+                return t;
+            }
+            else
+            {
+                return read();
+            }
+        }
+
+    private:
+        /// Produces the next token. See next().
+        TokenType read()
         {
             if (mIsValid == false)
             {
@@ -263,6 +413,7 @@ class Tokenizer
                     TokenType t(TokenKind::Newline, mLine, mToken);
                     mLine++;
                     mToken = 1;
+                    mColumn = 0;
                     return t;
                 }
             }
@@ -295,6 +446,7 @@ class Tokenizer
                         TokenType t(TokenKind::Newline, mLine, mToken);
                         mLine++;
                         mToken = 1;
+                        mColumn = 0;
                         return t;
                     }
                 }
@@ -307,18 +459,17 @@ class Tokenizer
             {
                 T value;
 
-                mInput >> value;
-
-                if (mInput.fail())
+                if (!mInput.extract(value, mParse))
                 {
                     mIsValid = false;
                     return TokenType(TokenKind::Invalid, mLine, mToken);
                 }
                 else
                 {
-                    if (VAL(value))
+                    if (mValidate(value))
                     {
-                        return TokenType(value, mLine, mToken++);
+                        return TokenType(std::move(value), mLine, mToken++,
+                                         mColumn++);
                     }
                     else
                     {
@@ -329,3 +480,40 @@ class Tokenizer
             }
         }
 };
+
+/// The tokenizer form that takes the validity and equality predicates as
+/// function pointers. See BasicTokenizer.
+/// @tparam The predicate that checks whether a given character is valid.
+/// @tparam The equality predicate for the Token objects produced.
+template<typename T,
+         bool VAL(const T &),
+         bool EQ(const T &, const T &),
+         typename Input = StreamInput,
+         typename Parse = DefaultParse<T>>
+using Tokenizer = BasicTokenizer<T, FunctionValidate<T, VAL>,
+                                 FunctionEqual<T, EQ>, Input, Parse>;
+
+/// A tokenizer for printable ASCII characters, as in diff_checker_char.cpp.
+template<typename Input = ByteInput>
+using CharTokenizer = BasicTokenizer<char, PrintableCharValidate,
+                                     ExactEqual<char>, Input, CharParse>;
+
+/// A tokenizer for finite decimal numbers that are compared with tolerances
+/// per column (see ColumnToleranceEqual), as in diff_checker_real.cpp.
+template<typename Input = ByteInput>
+using RealTokenizer = BasicTokenizer<long double, FiniteValidate<long double>,
+                                     ColumnToleranceEqual<long double>, Input,
+                                     DecimalParse<long double>>;
+
+/// A tokenizer for decimal integers of any length that are compared exactly,
+/// as in diff_checker_int.cpp.
+template<typename Input = ByteInput>
+using IntegerTokenizer = BasicTokenizer<Integer, AnyValidate<Integer>,
+                                        ExactEqual<Integer>, Input,
+                                        IntegerParse>;
+
+/// A tokenizer for words, i.e., whitespace-delimited strings of printable
+/// ASCII characters, that are compared exactly.
+template<typename Input = ByteInput>
+using WordTokenizer = BasicTokenizer<string, PrintableWordValidate,
+                                     ExactEqual<string>, Input, StreamParse>;
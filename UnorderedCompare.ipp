@@ -0,0 +1,426 @@
+// Author: Hakan Yıldız
+// Shared under MIT License. See the file LICENSE for more info.
+
+/// @file UnorderedCompare.ipp
+/// Implements the unordered mode of the checkers, in which the lines of
+/// <claimed_output_file> may come in any order: the files match if they have
+/// the same lines, each the same number of times. Two lines are the same if
+/// their tokens are, as read by the Tokenizer of the checker, which must
+/// compare its values exactly. (See diff_checker_unordered_case.)
+///
+/// The lines of <correct_output_file> are counted in a hash table (see
+/// LineMultiset), and each line of <claimed_output_file> is taken out of it as
+/// soon as it is read. Thus, the first line that is not expected (or is
+/// repeated more often than expected) is found without reading the rest of a
+/// pipe. Otherwise, a line that is left in the table is reported as missing.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "diff_checker_base.ipp"
+
+using std::size_t;
+using std::string;
+using std::string_view;
+using std::uint64_t;
+using std::vector;
+
+/// The byte that follows each value in the key of a line (see LineMultiset),
+/// which no value contains, so that the tokens of a key are delimited.
+constexpr char UnorderedValueEnd = '\x01';
+
+/// A multiset of lines in an open-addressing hash table with linear probing.
+/// A line is given by its key: The short strings of its tokens (see
+/// Token::appendTo), each valid one followed by UnorderedValueEnd. The keys
+/// are kept one after another in a single buffer, and the slots only refer to
+/// them, so that the table has a flat layout.
+class LineMultiset
+{
+    private:
+        /// A slot of the table, which refers to the first line with a key.
+        struct Slot
+        {
+            uint64_t hash;   ///< The hash of the key.
+            size_t offset;   ///< The offset of the key in mKeys.
+            size_t length;   ///< The length of the key.
+            uint64_t count;  ///< The number of lines with the key that are left.
+            uint64_t line;   ///< The line number of the first one, or 0 if free.
+        };
+
+        vector<char> mKeys;  ///< The keys of the slots, one after another.
+        vector<Slot> mSlots; ///< The slots, whose count is a power of two.
+        size_t mUsed;        ///< The number of slots in use.
+        uint64_t mSize;      ///< The underlying field for size().
+
+        /// Hashes a key, eight bytes at a time.
+        static uint64_t hash(string_view key)
+        {
+            uint64_t hash = 0x9E3779B97F4A7C15 ^ key.size();
+            size_t i = 0;
+
+            for (; i < key.size(); i += 8)
+            {
+                uint64_t word = 0;
+
+                std::memcpy(&word, key.data() + i, std::min<size_t>(8, key.size() - i));
+                hash = (hash ^ word) * 0xBF58476D1CE4E5B9;
+                hash ^= hash >> 31;
+            }
+
+            return hash;
+        }
+
+        /// The key of a slot.
+        string_view key(const Slot &slot) const
+        {
+            return string_view(mKeys.data() + slot.offset, slot.length);
+        }
+
+        /// Finds the slot of a key, or the free slot where it would go.
+        Slot & find(string_view key, uint64_t hash)
+        {
+            size_t mask = mSlots.size() - 1;
+
+            for (size_t i = static_cast<size_t>(hash) & mask; ; i = (i + 1) & mask)
+            {
+                Slot &slot = mSlots[i];
+
+                if (slot.line == 0 ||
+                    (slot.hash == hash && this->key(slot) == key))
+                {
+                    return slot;
+                }
+            }
+        }
+
+        /// Doubles the number of slots.
+        void grow()
+        {
+            vector<Slot> slots(2 * mSlots.size(), Slot{0, 0, 0, 0, 0});
+            size_t mask = slots.size() - 1;
+
+            for (const Slot &slot : mSlots)
+            {
+                if (slot.line != 0)
+                {
+                    size_t i = static_cast<size_t>(slot.hash) & mask;
+
+                    while (slots[i].line != 0)
+                    {
+                        i = (i + 1) & mask;
+                    }
+
+                    slots[i] = slot;
+                }
+            }
+
+            mSlots.swap(slots);
+        }
+
+    public:
+        /// Constructs an empty multiset.
+        LineMultiset() :
+              mKeys(), mSlots(1024, Slot{0, 0, 0, 0, 0}), mUsed(0), mSize(0)
+        {
+        }
+
+        /// The number of lines left.
+        uint64_t size() const
+        {
+            return mSize;
+        }
+
+        /// Adds a line.
+        /// @param key  The key of the line.
+        /// @param line The line number of the line, from 1.
+        void add(string_view key, uint64_t line)
+        {
+            uint64_t hash = LineMultiset::hash(key);
+            Slot *slot = &find(key, hash);
+
+            if (slot->line == 0)
+            {
+                // Keep the load factor at most 1/2.
+                if (2 * (mUsed + 1) > mSlots.size())
+                {
+                    grow();
+                    slot = &find(key, hash);
+                }
+
+                *slot = Slot{hash, mKeys.size(), key.size(), 0, line};
+                mKeys.insert(mKeys.end(), key.begin(), key.end());
+                mUsed++;
+            }
+
+            slot->count++;
+            mSize++;
+        }
+
+        /// Takes a line out, if there is one left with the key.
+        /// @param key The key of the line.
+        /// @return Whether there was a line left with the key.
+        bool remove(string_view key)
+        {
+            Slot &slot = find(key, hash(key));
+
+            if (slot.count == 0)
+            {
+                return false;
+            }
+
+            slot.count--;
+            mSize--;
+            return true;
+        }
+
+        /// Finds the key with a line left whose first line number is the lowest.
+        /// @param key  Set to the key, if there is any line left.
+        /// @param line Set to the line number of its first line.
+        /// @return Whether there is any line left.
+        bool firstLeft(string_view &key, uint64_t &line) const
+        {
+            const Slot *first = nullptr;
+
+            for (const Slot &slot : mSlots)
+            {
+                if (slot.count > 0 && (first == nullptr || slot.line < first->line))
+                {
+                    first = &slot;
+                }
+            }
+
+            if (first == nullptr)
+            {
+                return false;
+            }
+
+            key = this->key(*first);
+            line = first->line;
+            return true;
+        }
+};
+
+/// Reads the tokens of a line into its key (see LineMultiset).
+/// @param tokenizer The tokenizer to read from.
+/// @param key       Set to the key of the line.
+/// @return The token that ends the line, i.e., a newline, the end of the file
+///         or an invalid token.
+template<typename Tokenizer>
+typename Tokenizer::TokenType readUnorderedLine(Tokenizer &tokenizer, string &key)
+{
+    key.clear();
+
+    while (true)
+    {
+        typename Tokenizer::TokenType token = tokenizer.next();
+
+        switch (token.kind())
+        {
+            case Tokenizer::TokenKind::Valid:
+                token.appendTo(key);
+                key += UnorderedValueEnd;
+                break;
+            case Tokenizer::TokenKind::Space:
+                key += ' ';
+                break;
+            default:
+                return token;
+        }
+    }
+}
+
+/// Appends a line as it is shown, i.e., its key without the value ends.
+/// @param buffer The buffer to append to, e.g., a TailBuffer.
+/// @param key    The key of the line.
+template<typename Buffer>
+void appendUnorderedLine(Buffer &buffer, string_view key)
+{
+    for (char c : key)
+    {
+        if (c != UnorderedValueEnd)
+        {
+            buffer.append(&c, 1);
+        }
+    }
+}
+
+/// Checks a single test case in the unordered mode. See the documentation of
+/// UnorderedCompare.ipp and diff_checker_base.
+/// @tparam Tokenizer  The tokenizer to parse the output files, whose equal
+///                    policy must be ExactEqual, and whose short strings must
+///                    be the same for equal values only, e.g., CharTokenizer.
+/// @tparam ShowDiff   Whether to show the first line that does not match.
+/// @tparam ShowOutput Whether to show <claimed_output_file> up to that line.
+/// @param claimedOutputPath The <claimed_output_file> parameter.
+/// @param correctOutputPath The <correct_output_file> parameter.
+/// @param hidden            The <hidden> parameter.
+/// @param output            The buffer to write the output to.
+/// @return The exit code of the checker for the test case.
+template<typename Tokenizer, bool ShowDiff, bool ShowOutput>
+int diff_checker_unordered_case(const char *claimedOutputPath,
+                                const char *correctOutputPath,
+                                const string &hidden,
+                                OutputBuffer &output)
+{
+    static_assert(std::is_same_v<typename Tokenizer::EqualType,
+                                 ExactEqual<typename Tokenizer::ValueType>> &&
+                  !std::is_floating_point_v<typename Tokenizer::ValueType>,
+                  "The lines must be hashed by exactly compared values.");
+
+    if (hidden != "0" && hidden != "1")
+    {
+        cerr << "Invalid test-case-hidden parameter." << endl;
+        return 1;
+    }
+
+    const bool isTestCaseHidden = (hidden == "1");
+
+    typename Tokenizer::InputType claimedInput(claimedOutputPath);
+
+    if (claimedInput.fail())
+    {
+        output << "0|Error opening the output file." << '\n';
+        return 0;
+    }
+
+    typename Tokenizer::InputType correctInput(correctOutputPath);
+
+    if (correctInput.fail())
+    {
+        cerr << "Error opening the ground-truth file." << endl;
+        return 1;
+    }
+
+    LineMultiset expected;
+    string key;
+
+    {
+        Tokenizer correct(correctInput);
+
+        while (true)
+        {
+            typename Tokenizer::TokenType end = readUnorderedLine(correct, key);
+
+            if (end.kind() == Tokenizer::TokenKind::Invalid)
+            {
+                cerr << "Ground-truth file format is invalid." << endl;
+                return 1;
+            }
+
+            expected.add(key, end.line());
+
+            if (end.kind() == Tokenizer::TokenKind::EndOfFile)
+            {
+                break;
+            }
+        }
+    }
+
+    // Only the tail of the output up to the mismatch is shown.
+    TailBuffer checkerOutput(ShownOutputLines, ShownOutputBytes);
+    Tokenizer claimed(claimedInput);
+    typename Tokenizer::TokenType end;
+    bool isUnexpected = false;
+
+    while (true)
+    {
+        end = readUnorderedLine(claimed, key);
+
+        if constexpr (ShowOutput)
+        {
+            appendUnorderedLine(checkerOutput, key);
+        }
+
+        if (end.kind() == Tokenizer::TokenKind::Invalid)
+        {
+            break;
+        }
+        else if (!expected.remove(key))
+        {
+            isUnexpected = true;
+            break;
+        }
+        else if (end.kind() == Tokenizer::TokenKind::EndOfFile)
+        {
+            if (expected.size() == 0)
+            {
+                output << "1|Correct output.";
+                return 0;
+            }
+
+            break;
+        }
+
+        if constexpr (ShowOutput)
+        {
+            checkerOutput.append('\n');
+        }
+    }
+
+    CheckerStatsTimer outputTimer(checkerStats.outputNanoseconds);
+
+    if constexpr (ShowDiff)
+    {
+        if (isTestCaseHidden)
+        {
+            output << "0|Wrong output. (Mismatch intentionally hidden.)" << '\n';
+        }
+        else if (end.kind() == Tokenizer::TokenKind::Invalid)
+        {
+            output << "0|Unexpected <invalid-format> at line " << end.line()
+                   << ", token " << end.token() << "." << '\n';
+        }
+        else if (isUnexpected)
+        {
+            output << "0|Unexpected line " << end.line() << ": '";
+            appendUnorderedLine(output, key);
+            output << "'. (It is not expected, or not this many times.)" << '\n';
+        }
+        else
+        {
+            string_view missing;
+            uint64_t missingLine = 0;
+
+            expected.firstLeft(missing, missingLine);
+            output << "0|Missing line: '";
+            appendUnorderedLine(output, missing);
+            output << "'. (It is line " << missingLine << " of the expected output.)" << '\n';
+        }
+    }
+    else
+    {
+        output << "0|Wrong output." << '\n';
+    }
+
+    if constexpr (ShowOutput)
+    {
+        if (isTestCaseHidden)
+        {
+            output << "(Your output is intentionally hidden.)" << '\n';
+        }
+        else
+        {
+            output << "Your output (as parsed):" << '\n' << checkerOutput.str(".....");
+
+            if (end.kind() == Tokenizer::TokenKind::Invalid)
+            {
+                output << "..?..";
+            }
+            else if (end.kind() != Tokenizer::TokenKind::EndOfFile)
+            {
+                output << "\n.....";
+            }
+
+            output << '\n';
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,157 @@
+// Author: Hakan Yıldız
+// Shared under MIT License. See the file LICENSE for more info.
+
+/// @file decimal_parse.cpp
+/// Implements a benchmark that compares the DecimalParse policy against the
+/// operator>> path for reading long double tokens, as done in
+/// diff_checker_real.cpp. The expected parameters are:
+///     [<count>]
+/// where <count> is the number of generated numbers (1000000 by default). The
+/// numbers are formatted as a typical numeric homework would print them.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Tokenizer.ipp"
+
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+
+/// Predicate for validating tokens, as in diff_checker_real.cpp.
+bool val(const long double &a)
+{
+    return std::isfinite(a);
+}
+
+/// Predicate for comparing tokens bitwise, to cross-check the parsers.
+bool eq(const long double &a, const long double &b)
+{
+    return a == b || (std::isnan(a) && std::isnan(b));
+}
+
+/// Generates the benchmark input: a table of numbers in mixed formats.
+string generate(size_t count)
+{
+    std::mt19937_64 random(42);
+    std::uniform_real_distribution<double> uniform(-1000.0, 1000.0);
+    std::uniform_int_distribution<int> format(0, 3);
+    string text;
+    char buffer[64];
+
+    for (size_t i = 0; i < count; i++)
+    {
+        double x = uniform(random);
+
+        switch (format(random))
+        {
+            case 0:
+                std::snprintf(buffer, sizeof(buffer), "%.6f", x);
+                break;
+            case 1:
+                std::snprintf(buffer, sizeof(buffer), "%g", x);
+                break;
+            case 2:
+                std::snprintf(buffer, sizeof(buffer), "%.17g", x * 1e-9);
+                break;
+            default:
+                std::snprintf(buffer, sizeof(buffer), "%lld",
+                              static_cast<long long>(x * 1000.0));
+                break;
+        }
+
+        text += buffer;
+        text += (i % 8 == 7) ? '\n' : ' ';
+    }
+
+    return text;
+}
+
+/// Tokenizes the given input completely, returning the parsed values.
+template<typename Tokenizer>
+vector<long double> run(typename Tokenizer::InputType &input)
+{
+    Tokenizer tokenizer(input);
+    vector<long double> values;
+
+    while (true)
+    {
+        auto token = tokenizer.next();
+
+        if (token.kind() == Tokenizer::TokenKind::Valid)
+        {
+            values.push_back(token.value());
+        }
+        else if (token.kind() == Tokenizer::TokenKind::EndOfFile)
+        {
+            return values;
+        }
+        else if (token.kind() == Tokenizer::TokenKind::Invalid)
+        {
+            std::cerr << "Unexpected invalid token." << endl;
+            std::exit(1);
+        }
+    }
+}
+
+/// Runs and reports a benchmark case.
+template<typename Tokenizer, typename MakeInput>
+vector<long double> report(const char *name, const string &text,
+                           MakeInput makeInput)
+{
+    auto input = makeInput();
+    auto start = std::chrono::steady_clock::now();
+    vector<long double> values = run<Tokenizer>(*input);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    cout << name << ": "
+         << elapsed.count() << " s, "
+         << text.size() / elapsed.count() / 1e6 << " MB/s, "
+         << values.size() / elapsed.count() / 1e6 << " M values/s" << endl;
+
+    return values;
+}
+
+/// Implements the program. See the documentation of decimal_parse.cpp.
+int main(int argc, char **argv)
+{
+    size_t count = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    string text = generate(count);
+
+    typedef Tokenizer<long double, val, eq, StreamInput> StreamTokenizer;
+    typedef Tokenizer<long double, val, eq, ByteInput, StreamParse> ViewTokenizer;
+    typedef Tokenizer<long double, val, eq, ByteInput,
+                      DecimalParse<long double>> DecimalTokenizer;
+
+    std::istringstream stream(text);
+
+    auto streamValues = report<StreamTokenizer>("istream >>", text, [&]()
+    {
+        return std::make_unique<StreamInput>(stream);
+    });
+    auto viewValues = report<ViewTokenizer>("ByteInput + StreamParse", text, [&]()
+    {
+        return std::make_unique<ByteInput>(text.data(), text.data() + text.size());
+    });
+    auto decimalValues = report<DecimalTokenizer>("ByteInput + DecimalParse", text, [&]()
+    {
+        return std::make_unique<ByteInput>(text.data(), text.data() + text.size());
+    });
+
+    if (streamValues != viewValues || streamValues != decimalValues)
+    {
+        cout << "Parsed values differ between the paths." << endl;
+        return 1;
+    }
+
+    return 0;
+}
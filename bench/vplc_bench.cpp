@@ -0,0 +1,456 @@
+// Author: Hakan Yıldız
+// Shared under MIT License. See the file LICENSE for more info.
+
+/// @file vplc_bench.cpp
+/// Implements a benchmark suite for the checkers in diff_checker_base.ipp. The
+/// expected parameters are:
+///     [<max_size> [<directory>]]
+/// where <max_size> is the size of the largest generated file in bytes, with
+/// an optional K, M or G suffix (32M by default, 1G for the full suite), and
+/// <directory> is where the generated files are created (/tmp by default).
+///
+/// The suite generates pairs of claimed and correct output files for several
+/// scenarios, in sizes from 1 KB up to <max_size>, and runs the checker logic
+/// on them for every input backend (and the batched comparison of the real
+/// checker) and every ShowDiff/ShowOutput/LookAhead configuration. Each
+/// measurement runs in a forked process, so that its peak RSS is reported
+/// separately. Small files are checked repeatedly, and the time per check is
+/// reported. The tokens per second are counted up to the first mismatch, i.e.,
+/// the tokens the checker has to compare. The program exits with 1 if a check
+/// fails, or if a scenario without a mismatch is not accepted.
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "diff_checker_base.ipp"
+
+using std::cout;
+using std::endl;
+using std::flush;
+using std::ofstream;
+using std::setw;
+using std::string;
+using std::vector;
+
+/// The content of the generated files.
+enum class Content
+{
+    Text,  ///< Lines of words, for the char tokenizers.
+    Table  ///< Lines of decimal numbers, for the char and real tokenizers.
+};
+
+/// How the claimed file differs from the correct one.
+enum class Change
+{
+    None,          ///< The files are identical.
+    EarlyMismatch, ///< The files differ after 1% of the bytes.
+    LateMismatch,  ///< The files differ after 99% of the bytes.
+    Trailing,      ///< The claimed lines end with a space, which is ignored.
+    Tolerance      ///< The claimed numbers are off by just below 1%.
+};
+
+/// A benchmark scenario.
+struct Scenario
+{
+    const char *name; ///< The name, as reported.
+    Content content;  ///< The content of the files.
+    Change change;    ///< The difference between the files.
+};
+
+/// The scenarios to benchmark.
+const Scenario Scenarios[] =
+{
+    {"text-identical", Content::Text, Change::None},
+    {"text-early-mismatch", Content::Text, Change::EarlyMismatch},
+    {"text-late-mismatch", Content::Text, Change::LateMismatch},
+    {"text-trailing-spaces", Content::Text, Change::Trailing},
+    {"table-identical", Content::Table, Change::None},
+    {"table-late-mismatch", Content::Table, Change::LateMismatch},
+    {"table-tolerance", Content::Table, Change::Tolerance}
+};
+
+/// Checks whether the claimed file of a scenario is to be accepted.
+bool isAccepted(const Scenario &scenario)
+{
+    return scenario.change == Change::None || scenario.change == Change::Trailing ||
+           scenario.change == Change::Tolerance;
+}
+
+/// Generates a line of the correct file and the corresponding line of the
+/// claimed file, without the newline.
+/// @param random The random number generator.
+/// @param scenario The scenario.
+/// @param correct Set to the line of the correct file.
+/// @param claimed Set to the line of the claimed file.
+void generateLine(std::mt19937_64 &random, const Scenario &scenario,
+                  string &correct, string &claimed)
+{
+    char buffer[64];
+
+    correct.clear();
+    claimed.clear();
+
+    if (scenario.content == Content::Text)
+    {
+        // Short lines, so that the trailing whitespace is heavy.
+        size_t words = 1 + random() % 8;
+
+        for (size_t i = 0; i < words; i++)
+        {
+            if (i > 0)
+            {
+                correct += ' ';
+            }
+
+            size_t length = 1 + random() % 7;
+
+            for (size_t j = 0; j < length; j++)
+            {
+                correct += static_cast<char>('a' + random() % 26);
+            }
+        }
+
+        claimed = correct;
+    }
+    else
+    {
+        for (size_t i = 0; i < 8; i++)
+        {
+            // Numbers in [1, 1000), so that changing a leading digit is a
+            // mismatch under any tolerance.
+            double value = 1.0 + static_cast<double>(random() % 999000000) / 1e6;
+
+            if (i > 0)
+            {
+                correct += ' ';
+                claimed += ' ';
+            }
+
+            std::snprintf(buffer, sizeof(buffer), "%.6f", value);
+            correct += buffer;
+
+            if (scenario.change == Change::Tolerance)
+            {
+                value *= (i % 2 == 0) ? 1.0099 : 0.9901;
+                std::snprintf(buffer, sizeof(buffer), "%.9f", value);
+            }
+
+            claimed += buffer;
+        }
+    }
+
+    if (scenario.change == Change::Trailing)
+    {
+        claimed += ' ';
+    }
+}
+
+/// Generates the claimed and correct files of a scenario. The parts of the
+/// files are generated and written one line at a time, to keep the memory use
+/// of this process (which is inherited by the measurements) small.
+/// @param scenario The scenario.
+/// @param size The size of the correct file, approximately.
+/// @param claimedPath The path of the claimed file.
+/// @param correctPath The path of the correct file.
+void generate(const Scenario &scenario, size_t size,
+              const string &claimedPath, const string &correctPath)
+{
+    std::mt19937_64 random(42);
+    ofstream claimedFile(claimedPath, std::ios::binary);
+    ofstream correctFile(correctPath, std::ios::binary);
+    // The offset of the line to change, past any line if there is none.
+    size_t mismatch = (scenario.change == Change::EarlyMismatch) ? size / 100
+                    : (scenario.change == Change::LateMismatch) ? size / 100 * 99
+                    : std::numeric_limits<size_t>::max();
+    size_t written = 0;
+    string correct;
+    string claimed;
+
+    while (written < size)
+    {
+        generateLine(random, scenario, correct, claimed);
+
+        if (written <= mismatch && mismatch < written + correct.size() + 1)
+        {
+            char &first = claimed[0];
+            first = (scenario.content == Content::Text)
+                  ? static_cast<char>('a' + (first - 'a' + 1) % 26)
+                  : static_cast<char>('0' + (first - '0' == 9 ? 2 : first - '0' + 1));
+        }
+
+        correct += '\n';
+        claimed += '\n';
+        correctFile << correct;
+        claimedFile << claimed;
+        written += correct.size();
+    }
+}
+
+/// Counts the tokens up to (and including) the first mismatch, or the end.
+template<typename Tokenizer>
+uint64_t countTokens(const string &claimedPath, const string &correctPath)
+{
+    typename Tokenizer::InputType claimedInput(claimedPath.c_str());
+    typename Tokenizer::InputType correctInput(correctPath.c_str());
+    Tokenizer claimed(claimedInput);
+    Tokenizer correct(correctInput);
+    const typename Tokenizer::EqualType equal {};
+    uint64_t count = 0;
+
+    while (true)
+    {
+        auto claimedToken = claimed.next();
+        auto correctToken = correct.next();
+
+        count++;
+
+        if (!correctToken.isEqual(claimedToken, equal) ||
+            correctToken.kind() == Tokenizer::TokenKind::EndOfFile ||
+            correctToken.kind() == Tokenizer::TokenKind::Invalid)
+        {
+            return count;
+        }
+    }
+}
+
+/// Runs and reports a measurement of a checker configuration. See the
+/// template parameters of diff_checker_base.
+/// @param tokenizerName The name of the tokenizer, as reported.
+/// @param scenario The scenario.
+/// @param size The size of the files.
+/// @param tokens The number of tokens to compare. See countTokens().
+/// @param claimedPath The path of the claimed file.
+/// @param correctPath The path of the correct file.
+/// @return Whether the checks succeeded, with the grade that the scenario
+///         expects if it is accepted (see isAccepted()).
+template<typename Tokenizer, int LookAhead, bool ShowDiff, bool ShowOutput,
+         bool SkipEqualPrefix, bool BatchedCompare>
+bool measure(const char *tokenizerName, const Scenario &scenario, size_t size,
+             uint64_t tokens, const string &claimedPath,
+             const string &correctPath)
+{
+    // Check small files repeatedly, for at least 1 MB in total.
+    size_t repetitions = std::max<size_t>(1, (size_t(1) << 20) / size);
+
+    cout << std::left
+         << setw(22) << scenario.name
+         << setw(11) << size
+         << setw(14) << tokenizerName
+         << "diff=" << ShowDiff
+         << " output=" << ShowOutput
+         << " lookahead=" << setw(3) << LookAhead
+         << std::right << flush;
+
+    // The output of the first check comes through a pipe, to check its grade.
+    int result[2];
+
+    if (pipe(result) != 0)
+    {
+        cout << " failed to run." << endl;
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid = fork();
+
+    if (pid == 0)
+    {
+        int null = open("/dev/null", O_WRONLY);
+        dup2(null, STDOUT_FILENO);
+        dup2(null, STDERR_FILENO);
+        close(result[0]);
+
+        int code = 0;
+        OutputBuffer output(MaxOutputBytes);
+
+        for (size_t i = 0; i < repetitions && code == 0; i++)
+        {
+            code = diff_checker_case<Tokenizer, LookAhead, ShowDiff, ShowOutput,
+                                     SkipEqualPrefix, BatchedCompare>(
+                claimedPath.c_str(), correctPath.c_str(), "0",
+                DiffCheckerOptions<Tokenizer>(), output);
+            output.flush(i == 0 ? result[1] : STDOUT_FILENO);
+
+            if (i == 0)
+            {
+                close(result[1]);
+            }
+        }
+
+        _exit(code);
+    }
+
+    close(result[1]);
+
+    // Read the whole output, so that the child never blocks on the pipe.
+    string firstOutput;
+    char buffer[4096];
+
+    while (true)
+    {
+        ssize_t count = read(result[0], buffer, sizeof(buffer));
+
+        if (count > 0)
+        {
+            firstOutput.append(buffer, static_cast<size_t>(count));
+        }
+        else if (count == 0 || errno != EINTR)
+        {
+            break;
+        }
+    }
+
+    close(result[0]);
+
+    int status = 0;
+    struct rusage usage;
+
+    if (pid < 0 || wait4(pid, &status, 0, &usage) != pid)
+    {
+        cout << " failed to run." << endl;
+        return false;
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    double seconds = elapsed.count() / static_cast<double>(repetitions);
+
+    cout << std::fixed << std::setprecision(6)
+         << setw(11) << seconds << " s"
+         << std::setprecision(1)
+         << setw(9) << size / seconds / 1e6 << " MB/s"
+         << std::setprecision(2)
+         << setw(9) << tokens / seconds / 1e6 << " Mtokens/s"
+         << setw(9) << usage.ru_maxrss << " KB peak RSS";
+
+    bool success = true;
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        cout << " (checker failed)";
+        success = false;
+    }
+    else if (isAccepted(scenario) && firstOutput.rfind("1|", 0) != 0)
+    {
+        cout << " (not accepted)";
+        success = false;
+    }
+
+    cout << std::defaultfloat << endl;
+    return success;
+}
+
+/// Runs the measurements of every configuration of a tokenizer.
+/// @return Whether all of the measurements succeeded. See measure().
+template<typename Tokenizer, int LookAhead, bool SkipEqualPrefix,
+         bool BatchedCompare = false>
+bool measureConfigurations(const char *tokenizerName, const Scenario &scenario,
+                           size_t size, uint64_t tokens,
+                           const string &claimedPath, const string &correctPath)
+{
+    bool success = true;
+
+    success &= measure<Tokenizer, 0, false, false, SkipEqualPrefix, BatchedCompare>(
+        tokenizerName, scenario, size, tokens, claimedPath, correctPath);
+    success &= measure<Tokenizer, 0, true, false, SkipEqualPrefix, BatchedCompare>(
+        tokenizerName, scenario, size, tokens, claimedPath, correctPath);
+    success &= measure<Tokenizer, 0, false, true, SkipEqualPrefix, BatchedCompare>(
+        tokenizerName, scenario, size, tokens, claimedPath, correctPath);
+    success &= measure<Tokenizer, 0, true, true, SkipEqualPrefix, BatchedCompare>(
+        tokenizerName, scenario, size, tokens, claimedPath, correctPath);
+    success &= measure<Tokenizer, LookAhead, false, true, SkipEqualPrefix,
+                       BatchedCompare>(
+        tokenizerName, scenario, size, tokens, claimedPath, correctPath);
+    success &= measure<Tokenizer, LookAhead, true, true, SkipEqualPrefix,
+                       BatchedCompare>(
+        tokenizerName, scenario, size, tokens, claimedPath, correctPath);
+
+    return success;
+}
+
+/// Parses a size with an optional K, M or G suffix.
+size_t parseSize(const char *text)
+{
+    char *end;
+    size_t size = std::strtoull(text, &end, 10);
+
+    switch (*end)
+    {
+        case 'G':
+            size <<= 10;
+            [[fallthrough]];
+        case 'M':
+            size <<= 10;
+            [[fallthrough]];
+        case 'K':
+            size <<= 10;
+            break;
+        default:
+            break;
+    }
+
+    return size;
+}
+
+/// Implements the program. See the documentation of vplc_bench.cpp.
+int main(int argc, char **argv)
+{
+    size_t maxSize = (argc > 1) ? parseSize(argv[1]) : (size_t(32) << 20);
+    string directory = (argc > 2) ? argv[2] : "/tmp";
+    string claimedPath = directory + "/vplc_bench_claimed." + std::to_string(getpid());
+    string correctPath = directory + "/vplc_bench_correct." + std::to_string(getpid());
+    bool success = true;
+
+    for (size_t size = 1 << 10; size <= maxSize; size <<= 5)
+    {
+        for (const Scenario &scenario : Scenarios)
+        {
+            generate(scenario, size, claimedPath, correctPath);
+
+            // The char checkers, as in diff_checker_char.cpp.
+            if (scenario.change != Change::Tolerance)
+            {
+                uint64_t tokens = countTokens<CharTokenizer<ByteInput>>(claimedPath,
+                                                                       correctPath);
+
+                success &= measureConfigurations<CharTokenizer<ByteInput>, 10, true>(
+                    "char/byte", scenario, size, tokens, claimedPath, correctPath);
+                success &= measureConfigurations<CharTokenizer<StreamInput>, 10, true>(
+                    "char/stream", scenario, size, tokens, claimedPath, correctPath);
+            }
+
+            // The real checkers, as in diff_checker_real.cpp.
+            if (scenario.content == Content::Table)
+            {
+                uint64_t tokens = countTokens<RealTokenizer<ByteInput>>(claimedPath,
+                                                                       correctPath);
+
+                success &= measureConfigurations<RealTokenizer<ByteInput>, 3, false>(
+                    "real/byte", scenario, size, tokens, claimedPath, correctPath);
+                success &= measureConfigurations<RealTokenizer<StreamInput>, 3, false>(
+                    "real/stream", scenario, size, tokens, claimedPath, correctPath);
+                success &= measureConfigurations<RealTokenizer<ByteInput>, 3, false,
+                                                 true>(
+                    "real/batched", scenario, size, tokens, claimedPath, correctPath);
+            }
+        }
+    }
+
+    std::remove(claimedPath.c_str());
+    std::remove(correctPath.c_str());
+
+    return success ? 0 : 1;
+}
@@ -11,72 +11,220 @@
 /// hidden. Content output (when applicable) is supressed if so. The output is
 /// in the following format:
 ///     <grade_ratio>|<further output>
+/// The files are read with the input backend of the provided Tokenizer (see
+/// Input.ipp), which is picked at compile time. When <claimed_output_file> is
+/// shown, only its last lines up to a mismatch are shown (see ShownOutputLines
+/// and ShownOutputBytes), preceded by "....." if anything before is omitted.
+/// <claimed_output_file> can also be a pipe (e.g., a FIFO) whose writer is still
+/// running, in which case the tokens are compared as they arrive, and the
+/// output is written at the first mismatch without waiting for the writer.
+///
+/// Alternatively, the checker can be run with the single parameter:
+///     --server
+/// in which case it checks many test cases in one process. Each line read from
+/// the standard input is a request with the four parameters above, separated
+/// by tabs. For each request, the output above is written followed by a '\0'
+/// character. The output is empty (i.e., only '\0') if the checker fails,
+/// where it would have exited with a non-zero code otherwise. With the single
+/// parameter:
+///     --binary-server
+/// the requests are the same, but each output is written as a binary record
+/// instead, whose header gives the grade ratio and the length of the further
+/// output (see OutputBuffer::flushRecord).
+///
+/// If the CHECKER_STATS macro is defined, the counters of each test case are
+/// written to the standard error (see CheckerStats.ipp).
+///
+/// If a digest file of <correct_output_file> is present (see Digest.ipp), a
+/// <claimed_output_file> with the same canonical digest is accepted without
+/// reading <correct_output_file> as tokens. Likewise, if a compiled file of
+/// <correct_output_file> is present (see CompiledOutput.ipp), its tokens are
+/// read from there rather than parsed. If a tolerance file of
+/// <correct_output_file> is present (see ColumnToleranceEqual), the values of
+/// the test case are compared with its tolerances.
 
+#pragma once
+
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <string>
+#include <type_traits>
+#include <vector>
 
+#include "BulkCompare.ipp"
+#include "CheckerStats.ipp"
+#include "CompiledOutput.ipp"
+#include "Digest.ipp"
+#include "OutputBuffer.ipp"
+#include "ParallelCompare.ipp"
+#include "TailBuffer.ipp"
+#include "TokenPairs.ipp"
 #include "Tokenizer.ipp"
 
 using std::cerr;
-using std::cout;
+using std::cin;
 using std::endl;
+using std::getline;
 using std::ifstream;
+using std::istream;
 using std::string;
+using std::vector;
 
+/// The number of lines of <claimed_output_file> that are shown up to (and
+/// including) the line of a mismatch, when the output is shown.
+constexpr size_t ShownOutputLines = 50;
 
-/// Implements the checker logic. See documentation of diff_checker_base.ipp.
-/// @tparam Tokenizer  The tokenizer to parse the output files.
-/// @tparam LookAhead  If ShowOutput is true, this integer tells how many tokens
-///                    to further print after finding a mismatch.
-/// @tparam ShowDiff   Whether to show the diff between the two output files.
-/// @tparam ShowOutput Whether to show <claimed_output_file>.
-template<typename Tokenizer, int LookAhead, bool ShowDiff, bool ShowOutput>
-int diff_checker_base(int argc, char **argv)
+/// The number of bytes of <claimed_output_file> that are shown up to (and
+/// including) a mismatch, when the output is shown.
+constexpr size_t ShownOutputBytes = 4096;
+
+/// The number of bytes of output that are written for a test case, beyond which
+/// the output is cut (see OutputBuffer).
+constexpr size_t MaxOutputBytes = 65536;
+
+/// The number of bytes of <correct_output_file>, after the skipped prefix, from
+/// which the parallel pre-pass in ParallelCompare.ipp is used.
+constexpr size_t ParallelMinimumBytes = size_t(64) << 20;
+
+/// The run-time options of diff_checker_base.
+/// @tparam Tokenizer The tokenizer to parse the output files.
+template<typename Tokenizer>
+struct DiffCheckerOptions
 {
-    if (argc < 5)
-    {
-        cerr << "Invalid parameters." << endl;
-        return 1;
-    }
+    /// The equal policy to compare the tokens with, which may hold state such
+    /// as tolerances.
+    typename Tokenizer::EqualType equal {};
 
-    const char *claimedOutputPath = argv[2];
-    const char *correctOutputPath = argv[3];
-    string argv4 = string(argv[4]);
+    /// The number of threads with which large files are compared in parallel
+    /// (see ParallelCompare.ipp), or 0 for one per core. Effective only with
+    /// the ByteInput backend.
+    unsigned threads = 1;
 
-    if (argv4 != "0" && argv4 != "1")
-    {
-        cerr << "Invalid test-case-hidden parameter." << endl;
-        return 1;
-    }
+    /// The suffix of the digest files of the tokenizer (see Digest.ipp), or
+    /// nullptr to not use digest files. Effective only with the ByteInput
+    /// backend.
+    const char *digestSuffix = nullptr;
 
-    const bool isTestCaseHidden = (argv4 == "1");
+    /// The suffix of the compiled files of the tokenizer (see
+    /// CompiledOutput.ipp), or nullptr to not use compiled files. Effective
+    /// only with the ByteInput backend.
+    const char *compiledSuffix = nullptr;
 
-    ifstream claimedStream(claimedOutputPath);
+    /// The suffix of the tolerance files of the test cases (see
+    /// ColumnToleranceEqual::load), or nullptr to not use tolerance files.
+    /// Effective only with an equal policy that loads them. The equal policy is
+    /// used for the test cases without a tolerance file.
+    const char *toleranceSuffix = nullptr;
+};
 
-    if (claimedStream.fail())
-    {
-        cout << "0|Error opening the output file." << endl;
-        return 0;
-    }
+/// Compares the tokens of a single test case, after its inputs are opened.
+/// See diff_checker_base for the template parameters.
+/// @tparam CorrectTokenizer The tokenizer of <correct_output_file>, i.e.,
+///                          Tokenizer or a CompiledTokenizer of it.
+/// @param claimedInput     The input of <claimed_output_file>.
+/// @param correctInput     The input of <correct_output_file>.
+/// @param correct          The tokenizer of <correct_output_file>, which may
+///                         read correctInput.
+/// @param isTestCaseHidden Whether the test case is hidden.
+/// @param options          The run-time options, with at least one thread.
+/// @param output           The buffer to write the output to.
+/// @return The exit code of the checker for the test case.
+template<typename Tokenizer, typename CorrectTokenizer, int LookAhead,
+         bool ShowDiff, bool ShowOutput, bool SkipEqualPrefix,
+         bool BatchedCompare>
+int diff_checker_compare(typename Tokenizer::InputType &claimedInput,
+                         typename Tokenizer::InputType &correctInput,
+                         CorrectTokenizer &correct,
+                         bool isTestCaseHidden,
+                         const DiffCheckerOptions<Tokenizer> &options,
+                         OutputBuffer &output)
+{
+    static_assert(!BatchedCompare || SupportsBatchedTokenPairs<Tokenizer>);
 
-    ifstream correctStream(correctOutputPath);
+    Tokenizer claimed(claimedInput);
+    std::conditional_t<BatchedCompare,
+                       BatchedTokenPairs<Tokenizer, CorrectTokenizer>,
+                       SequentialTokenPairs<Tokenizer, CorrectTokenizer>>
+        pairs(claimed, correct, options.equal);
 
-    if (correctStream.fail())
+    // Only the tail of the output before a mismatch is kept, so that memory
+    // use does not grow with the size of the output.
+    TailBuffer checkerOutput(ShownOutputLines, ShownOutputBytes);
+
+    if constexpr (SkipEqualPrefix &&
+                  std::is_same_v<typename Tokenizer::InputType, ByteInput>)
     {
-        cerr << "Error opening the ground-truth file." << endl;
-        return 1;
+        if (claimedInput.isContiguous() && correctInput.isContiguous())
+        {
+            const char *prefix = claimedInput.position();
+            uint64_t lines;
+            size_t length = skippablePrefix(prefix,
+                                            correctInput.position(),
+                                            std::min(claimedInput.available(),
+                                                     correctInput.available()),
+                                            lines);
+
+            if constexpr (ShowOutput)
+            {
+                // Append the tail of the prefix as parsed, i.e., without spaces
+                // preceding newlines. The rest would not be kept anyway.
+                size_t tail = length - std::min(length, ShownOutputBytes);
+
+                checkerOutput.skip(tail);
+
+                for (size_t i = tail; i < length; i++)
+                {
+                    if (prefix[i] != ' ' || prefix[i + 1] != '\n')
+                    {
+                        checkerOutput.append(prefix[i]);
+                    }
+                }
+            }
+
+            claimed.skipLines(length, lines);
+            correct.skipLines(length, lines);
+        }
     }
 
-    Tokenizer claimed(claimedStream);
-    Tokenizer correct(correctStream);
+    if constexpr (std::is_same_v<typename Tokenizer::InputType, ByteInput>)
+    {
+        if (options.threads > 1 &&
+            claimedInput.isContiguous() && correctInput.isContiguous() &&
+            correctInput.available() >= ParallelMinimumBytes)
+        {
+            ParallelSearchResult result =
+                parallelSearch<Tokenizer>(claimedInput.position(),
+                                          claimedInput.available(),
+                                          correctInput.position(),
+                                          correctInput.available(),
+                                          options.equal, options.threads);
+
+            if (!result.mayDiffer)
+            {
+                output << "1|Correct output.";
+                return 0;
+            }
+
+            // Tokenize sequentially from where the tokens may differ.
+            if constexpr (ShowOutput)
+            {
+                if (result.claimedOffset > 0)
+                {
+                    checkerOutput.skip(result.claimedOffset);
+                }
+            }
 
-    stringstream checkerOutput;
+            claimed.skipLines(result.claimedOffset, result.lines);
+            correct.skipLines(result.correctOffset, result.lines);
+        }
+    }
 
     while (true)
     {
-        auto claimedToken = claimed.next();
-        auto correctToken = correct.next();
+        bool isEqual = pairs.next();
+        const typename Tokenizer::TokenType &claimedToken = pairs.claimedToken();
+        const typename Tokenizer::TokenType &correctToken = pairs.correctToken();
 
         if (correctToken.kind() == Tokenizer::TokenKind::Invalid)
         {
@@ -84,19 +232,24 @@ int diff_checker_base(int argc, char **argv)
             return 1;
         }
 
-        checkerOutput << claimedToken.sstr();
+        if constexpr (ShowOutput)
+        {
+            claimedToken.appendTo(checkerOutput);
+        }
 
-        if (!correctToken.isEqual(claimedToken))
+        if (!isEqual)
         {
+            CheckerStatsTimer outputTimer(checkerStats.outputNanoseconds);
+
             if constexpr (ShowDiff)
             {
                 if (isTestCaseHidden)
                 {
-                    cout << "0|Wrong output. (Mismatch intentionally hidden.)" << endl;
+                    output << "0|Wrong output. (Mismatch intentionally hidden.)" << '\n';
                 }
                 else
                 {
-                    cout << "0|Unexpected "
+                    output << "0|Unexpected "
                          << claimedToken.lstr()
                          << " at line "
                          << claimedToken.line()
@@ -104,53 +257,71 @@ int diff_checker_base(int argc, char **argv)
                          << claimedToken.token()
                          << ", while expecting "
                          << correctToken.lstr()
-                         << "." << endl;
+                         << "." << '\n';
                 }
             }
             else
             {
-                cout << "0|Wrong output." << endl;
+                output << "0|Wrong output." << '\n';
             }
 
             if constexpr (ShowOutput)
             {
                 if (isTestCaseHidden)
                 {
-                    cout << "(Your output is intentionally hidden.)" << endl;
+                    output << "(Your output is intentionally hidden.)" << '\n';
                 }
                 else
                 {
-                    cout << "Your output (as parsed):" << endl;
+                    output << "Your output (as parsed):" << '\n';
+
+                    string lookAheadOutput;
+                    typename Tokenizer::TokenType lookAheadToken = claimedToken;
+                    bool isCut = false;
+
+                    // The tokens after the mismatch are shown as far as they
+                    // have arrived, without waiting for the writer of a pipe.
+                    if constexpr (std::is_same_v<typename Tokenizer::InputType, ByteInput>)
+                    {
+                        claimedInput.stopWaiting();
+                    }
 
                     for (int i = 0; i < LookAhead; i++)
                     {
-                        if (claimedToken.kind() == Tokenizer::TokenKind::EndOfFile ||
-                            claimedToken.kind() == Tokenizer::TokenKind::Invalid)
+                        if (lookAheadToken.kind() == Tokenizer::TokenKind::EndOfFile ||
+                            lookAheadToken.kind() == Tokenizer::TokenKind::Invalid)
                         {
                             break;
                         }
                         else
                         {
-                            claimedToken = claimed.next();
-                            checkerOutput << claimedToken.sstr();
+                            lookAheadToken = pairs.nextClaimed();
+
+                            if constexpr (std::is_same_v<typename Tokenizer::InputType, ByteInput>)
+                            {
+                                if (lookAheadToken.kind() == Tokenizer::TokenKind::EndOfFile &&
+                                    claimedInput.isCut())
+                                {
+                                    isCut = true;
+                                    break;
+                                }
+                            }
+
+                            lookAheadToken.appendTo(lookAheadOutput);
                         }
                     }
 
-                    if (claimedToken.kind() == Tokenizer::TokenKind::Invalid)
+                    if (lookAheadToken.kind() == Tokenizer::TokenKind::Invalid)
                     {
-                        checkerOutput << "..?..";
+                        lookAheadOutput += "..?..";
                     }
-                    else if (claimedToken.kind() != Tokenizer::TokenKind::EndOfFile)
-                    {
-                        checkerOutput << ".....";
-                    }
-
-                    for (char c : checkerOutput.str())
+                    else if (isCut ||
+                             lookAheadToken.kind() != Tokenizer::TokenKind::EndOfFile)
                     {
-                        cout << c;
+                        lookAheadOutput += ".....";
                     }
 
-                    cout << endl;
+                    output << checkerOutput.str(".....") << lookAheadOutput << '\n';
                 }
             }
 
@@ -158,8 +329,274 @@ int diff_checker_base(int argc, char **argv)
         }
         else if (correctToken.kind() == Tokenizer::TokenKind::EndOfFile)
         {
-            cout << "1|Correct output.";
+            output << "1|Correct output.";
             return 0;
         }
     }
 }
+
+/// Checks a single test case. See documentation of diff_checker_base.ipp.
+/// See diff_checker_base for the template parameters.
+/// @param claimedOutputPath The <claimed_output_file> parameter.
+/// @param correctOutputPath The <correct_output_file> parameter.
+/// @param hidden            The <hidden> parameter.
+/// @param options           The run-time options, with at least one thread.
+/// @param output            The buffer to write the output to.
+/// @return The exit code of the checker for the test case.
+template<typename Tokenizer, int LookAhead, bool ShowDiff, bool ShowOutput,
+         bool SkipEqualPrefix, bool BatchedCompare = false>
+int diff_checker_case(const char *claimedOutputPath,
+                      const char *correctOutputPath,
+                      const string &hidden,
+                      const DiffCheckerOptions<Tokenizer> &defaultOptions,
+                      OutputBuffer &output)
+{
+    if (hidden != "0" && hidden != "1")
+    {
+        cerr << "Invalid test-case-hidden parameter." << endl;
+        return 1;
+    }
+
+    const bool isTestCaseHidden = (hidden == "1");
+
+    typename Tokenizer::InputType claimedInput(claimedOutputPath);
+
+    if (claimedInput.fail())
+    {
+        output << "0|Error opening the output file." << '\n';
+        return 0;
+    }
+
+    typename Tokenizer::InputType correctInput(correctOutputPath);
+
+    if (correctInput.fail())
+    {
+        cerr << "Error opening the ground-truth file." << endl;
+        return 1;
+    }
+
+    // The options of the test case, whose tolerances are read once from its
+    // tolerance file, if any.
+    DiffCheckerOptions<Tokenizer> options = defaultOptions;
+
+    if constexpr (requires (istream &input) { options.equal.load(input); })
+    {
+        ifstream toleranceFile;
+
+        if (options.toleranceSuffix != nullptr)
+        {
+            toleranceFile.open(correctOutputPath + string(options.toleranceSuffix));
+        }
+
+        if (toleranceFile.is_open() && !options.equal.load(toleranceFile))
+        {
+            cerr << "Tolerance file format is invalid." << endl;
+            return 1;
+        }
+    }
+
+    if constexpr (std::is_same_v<typename Tokenizer::InputType, ByteInput>)
+    {
+        // The digest and compiled files are only trusted for the bytes they
+        // were made from, whose raw digest is computed at most once. A compiled
+        // file whose stamp matches <correct_output_file> gives it instead.
+        CompiledOutput<typename Tokenizer::ValueType> compiled;
+        bool isCompiled = options.compiledSuffix != nullptr &&
+                          claimedInput.isContiguous() && correctInput.isContiguous() &&
+                          compiled.load((correctOutputPath +
+                                         string(options.compiledSuffix)).c_str());
+        string correctRaw;
+
+        if (isCompiled && compiled.isCompiledFrom(correctOutputPath))
+        {
+            correctRaw = compiled.rawDigest();
+        }
+
+        auto correctRawDigest = [&]() -> const string &
+        {
+            if (correctRaw.empty())
+            {
+                Digest digest;
+
+                digest.append(correctInput.position(), correctInput.available());
+                correctRaw = digest.hex();
+            }
+
+            return correctRaw;
+        };
+
+        string canonical;
+        string raw;
+
+        if (options.digestSuffix != nullptr &&
+            claimedInput.isContiguous() && correctInput.isContiguous() &&
+            readDigestFile(correctOutputPath + string(options.digestSuffix),
+                           canonical, raw) &&
+            correctRawDigest() == raw)
+        {
+            ByteInput digestInput(claimedInput.position(),
+                                  claimedInput.position() + claimedInput.available());
+            Tokenizer digestTokenizer(digestInput);
+            Digest claimedDigest;
+
+            if (appendCanonicalTokens(digestTokenizer, claimedDigest) &&
+                claimedDigest.hex() == canonical)
+            {
+                output << "1|Correct output.";
+                return 0;
+            }
+        }
+
+        if (isCompiled && compiled.rawDigest() == correctRawDigest())
+        {
+            CompiledTokenizer<Tokenizer> correct(compiled, correctInput);
+
+            return diff_checker_compare<Tokenizer, CompiledTokenizer<Tokenizer>,
+                                        LookAhead, ShowDiff, ShowOutput,
+                                        SkipEqualPrefix, BatchedCompare>(
+                claimedInput, correctInput, correct, isTestCaseHidden, options, output);
+        }
+    }
+
+    Tokenizer correct(correctInput);
+
+    return diff_checker_compare<Tokenizer, Tokenizer, LookAhead, ShowDiff,
+                                ShowOutput, SkipEqualPrefix, BatchedCompare>(
+        claimedInput, correctInput, correct, isTestCaseHidden, options, output);
+}
+
+/// Implements the parameter handling of a checker program, i.e., the single test
+/// case or the --server mode. See documentation of diff_checker_base.ipp.
+/// The output of each test case is buffered, and written with a single system
+/// call once the test case is checked (see OutputBuffer).
+/// @param checkCase The function that checks a single test case, given the
+///                  <claimed_output_file> and <correct_output_file> parameters
+///                  as const char *, the <hidden> parameter as a string and the
+///                  buffer to write the output to, and that returns the exit
+///                  code of the checker for the test case.
+template<typename CheckCase>
+int diff_checker_main(int argc, char **argv, CheckCase checkCase)
+{
+    OutputBuffer output(MaxOutputBytes);
+
+    auto check = [&](const char *claimedOutputPath, const char *correctOutputPath,
+                     const string &hidden)
+    {
+        if constexpr (CheckerStatsEnabled)
+        {
+            checkerStats.reset();
+
+            int code;
+
+            {
+                CheckerStatsTimer timer(checkerStats.totalNanoseconds);
+
+                code = checkCase(claimedOutputPath, correctOutputPath, hidden, output);
+            }
+
+            checkerStats.write(cerr);
+            return code;
+        }
+        else
+        {
+            return checkCase(claimedOutputPath, correctOutputPath, hidden, output);
+        }
+    };
+
+    const bool isServer = (argc == 2 && string(argv[1]) == "--server");
+    const bool isBinaryServer = (argc == 2 && string(argv[1]) == "--binary-server");
+
+    if (isServer || isBinaryServer)
+    {
+        string request;
+
+        while (getline(cin, request))
+        {
+            vector<string> fields;
+            size_t begin = 0;
+            size_t end;
+
+            while ((end = request.find('\t', begin)) != string::npos)
+            {
+                fields.push_back(request.substr(begin, end - begin));
+                begin = end + 1;
+            }
+
+            fields.push_back(request.substr(begin));
+
+            bool isFailed = false;
+
+            if (fields.size() != 4)
+            {
+                cerr << "Invalid request." << endl;
+                isFailed = true;
+            }
+            else if (check(fields[1].c_str(), fields[2].c_str(), fields[3]) != 0)
+            {
+                isFailed = true;
+            }
+
+            if (isBinaryServer)
+            {
+                output.flushRecord(STDOUT_FILENO, isFailed);
+            }
+            else
+            {
+                if (isFailed)
+                {
+                    output.clear();
+                }
+
+                output.flush(STDOUT_FILENO, string_view("\0", 1));
+            }
+        }
+
+        return 0;
+    }
+
+    if (argc < 5)
+    {
+        cerr << "Invalid parameters." << endl;
+        return 1;
+    }
+
+    int code = check(argv[2], argv[3], string(argv[4]));
+
+    output.flush(STDOUT_FILENO);
+    return code;
+}
+
+/// Implements the checker logic. See documentation of diff_checker_base.ipp.
+/// @tparam Tokenizer  The tokenizer to parse the output files.
+/// @tparam LookAhead  If ShowOutput is true, this integer tells how many tokens
+///                    to further print after finding a mismatch.
+/// @tparam ShowDiff   Whether to show the diff between the two output files.
+/// @tparam ShowOutput Whether to show <claimed_output_file>.
+/// @tparam SkipEqualPrefix Whether to skip the common prefix of the files with
+///                    the vectorized pre-pass in BulkCompare.ipp. Only valid if
+///                    the tokens are printable ASCII characters compared for
+///                    equality, and effective only with the ByteInput backend.
+/// @tparam BatchedCompare Whether to compare the tokens in batches with the
+///                    vectorized kernel in TokenPairs.ipp. Only valid if the
+///                    tokens are floating-point numbers compared with
+///                    ToleranceEqual.
+/// @param options The run-time options.
+template<typename Tokenizer, int LookAhead, bool ShowDiff, bool ShowOutput,
+         bool SkipEqualPrefix = false, bool BatchedCompare = false>
+int diff_checker_base(int argc, char **argv,
+                      DiffCheckerOptions<Tokenizer> options = {})
+{
+    if (options.threads == 0)
+    {
+        options.threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    return diff_checker_main(argc, argv,
+        [&](const char *claimedOutputPath, const char *correctOutputPath,
+            const string &hidden, OutputBuffer &output)
+        {
+            return diff_checker_case<Tokenizer, LookAhead, ShowDiff, ShowOutput,
+                                     SkipEqualPrefix, BatchedCompare>(
+                claimedOutputPath, correctOutputPath, hidden, options, output);
+        });
+}
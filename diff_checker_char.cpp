@@ -4,24 +4,24 @@
 /// @file diff_checker_char.cpp
 /// Implements a program that performs the logic in diff_checker_base.ipp, with
 /// the following properties:
-/// - The valid tokens are printable ASCII characters.
+/// - The valid tokens are printable ASCII characters. (See CharTokenizer.)
 /// - There is a look-ahead when printing output. (See the code for details.)
 /// - The SHOW_DIFF and SHOW_OUTPUT macros determine whether the diff and the
 ///   output should be shown.
+/// - The lines may be in any order if the UNORDERED_LINES macro is defined.
+///   (See UnorderedCompare.ipp.) The pre-passes, the digest files and the
+///   compiled files are not used then.
+/// - The byte-for-byte equal prefix of the files is skipped by a vectorized
+///   pre-pass before the token-level comparison.
+/// - The files are memory-mapped, unless the STREAM_INPUT macro is defined, in
+///   which case they are read through std::istream.
+/// - Large memory-mapped files are compared on CHECKER_THREADS threads (1 by
+///   default, i.e., sequentially, and 0 for one per core).
+/// - The digest files written by diff_digest.cpp and the compiled files written
+///   by diff_compile.cpp are used, if present.
 
 #include "diff_checker_base.ipp"
-
-/// Predicate for validating tokens.
-bool val(const char &a)
-{
-    return '!' <= a && a <= '~';
-}
-
-/// Predicate for comparing tokens.
-bool eq(const char &a, const char &b)
-{
-    return a == b;
-}
+#include "UnorderedCompare.ipp"
 
 #ifdef SHOW_DIFF
     #define SHOW_DIFF_FLAG true
@@ -35,11 +35,35 @@ bool eq(const char &a, const char &b)
     #define SHOW_OUTPUT_FLAG false
 #endif
 
+#ifdef STREAM_INPUT
+    #define INPUT_TYPE StreamInput
+#else
+    #define INPUT_TYPE ByteInput
+#endif
+
+#ifndef CHECKER_THREADS
+    #define CHECKER_THREADS 1
+#endif
+
 /// Implements the program. See the documentation of diff_checker_char.cpp.
 int main(int argc, char **argv)
 {
-    return diff_checker_base<Tokenizer<char, val, eq>,
+#ifdef UNORDERED_LINES
+    return diff_checker_main(argc, argv,
+                             diff_checker_unordered_case<CharTokenizer<INPUT_TYPE>,
+                                                         SHOW_DIFF_FLAG,
+                                                         SHOW_OUTPUT_FLAG>);
+#else
+    DiffCheckerOptions<CharTokenizer<INPUT_TYPE>> options;
+
+    options.threads = CHECKER_THREADS;
+    options.digestSuffix = CharDigestSuffix;
+    options.compiledSuffix = CharCompiledSuffix;
+
+    return diff_checker_base<CharTokenizer<INPUT_TYPE>,
                              10, // The LookAhead template parameter.
                              SHOW_DIFF_FLAG,
-                             SHOW_OUTPUT_FLAG>(argc, argv);
+                             SHOW_OUTPUT_FLAG,
+                             true>(argc, argv, options); // Skip the equal prefix.
+#endif
 }
@@ -0,0 +1,67 @@
+// Author: Hakan Yıldız
+// Shared under MIT License. See the file LICENSE for more info.
+
+/// @file diff_checker_int.cpp
+/// Implements a program that performs the logic in diff_checker_base.ipp, with
+/// the following properties:
+/// - The valid tokens are decimal integers of any length, which are compared
+///   exactly, e.g., "+007" is equal to "7". (See IntegerTokenizer.)
+/// - A mismatch is reported as a whole number, rather than as the first digit
+///   that differs.
+/// - There is a look-ahead when printing output. (See the code for details.)
+/// - The SHOW_DIFF and SHOW_OUTPUT macros determine whether the diff and the
+///   output should be shown.
+/// - The lines may be in any order if the UNORDERED_LINES macro is defined.
+///   (See UnorderedCompare.ipp.) The pre-passes, the digest files and the
+///   compiled files are not used then.
+/// - The integers are read with the locale-free IntegerParse policy, which
+///   converts 8 digits at a time.
+/// - The files are memory-mapped, unless the STREAM_INPUT macro is defined, in
+///   which case they are read through std::istream.
+/// - Large memory-mapped files are compared on CHECKER_THREADS threads (1 by
+///   default, i.e., sequentially, and 0 for one per core).
+
+#include "diff_checker_base.ipp"
+#include "UnorderedCompare.ipp"
+
+#ifdef SHOW_DIFF
+    #define SHOW_DIFF_FLAG true
+#else
+    #define SHOW_DIFF_FLAG false
+#endif
+
+#ifdef SHOW_OUTPUT
+    #define SHOW_OUTPUT_FLAG true
+#else
+    #define SHOW_OUTPUT_FLAG false
+#endif
+
+#ifdef STREAM_INPUT
+    #define INPUT_TYPE StreamInput
+#else
+    #define INPUT_TYPE ByteInput
+#endif
+
+#ifndef CHECKER_THREADS
+    #define CHECKER_THREADS 1
+#endif
+
+/// Implements the program. See the documentation of diff_checker_int.cpp.
+int main(int argc, char **argv)
+{
+#ifdef UNORDERED_LINES
+    return diff_checker_main(argc, argv,
+                             diff_checker_unordered_case<IntegerTokenizer<INPUT_TYPE>,
+                                                         SHOW_DIFF_FLAG,
+                                                         SHOW_OUTPUT_FLAG>);
+#else
+    DiffCheckerOptions<IntegerTokenizer<INPUT_TYPE>> options;
+
+    options.threads = CHECKER_THREADS;
+
+    return diff_checker_base<IntegerTokenizer<INPUT_TYPE>,
+                             3, // The LookAhead template parameter.
+                             SHOW_DIFF_FLAG,
+                             SHOW_OUTPUT_FLAG>(argc, argv, options);
+#endif
+}
@@ -5,42 +5,35 @@
 /// Implements a program that performs the logic in diff_checker_base.ipp, with
 /// the following properties:
 /// - The valid tokens are finite decimal numbers.
-/// - Two numbers are equal if they are within a threshold or within a ratio.
-///   (See the code.)
+/// - Two numbers are equal if they are within a threshold or within a ratio,
+///   given by the ABSOLUTE_TOLERANCE and RELATIVE_TOLERANCE macros. (See the
+///   code and ToleranceEqual.) A test case can give its own tolerances, per
+///   column, in a tolerance file next to <correct_output_file>, with the name
+///   of that file followed by ".tolerance". (See ColumnToleranceEqual.)
 /// - There is a look-ahead when printing output. (See the code for details.)
 /// - The SHOW_DIFF and SHOW_OUTPUT macros determine whether the diff and the
 ///   output should be shown.
+/// - The numbers are read with the locale-free DecimalParse policy.
+/// - The numbers are compared in batches with a vectorized kernel if the
+///   BATCHED_COMPARE macro is defined. (See BatchedTokenPairs.)
+/// - The files are memory-mapped, unless the STREAM_INPUT macro is defined, in
+///   which case they are read through std::istream.
+/// - Large memory-mapped files are compared on CHECKER_THREADS threads (1 by
+///   default, i.e., sequentially, and 0 for one per core).
+/// - The digest files written by diff_digest.cpp and the compiled files written
+///   by diff_compile.cpp are used, if present.
 
 #include "diff_checker_base.ipp"
 
-#include <cmath>
-using std::isfinite;
-
-/// Predicate for validating tokens.
-bool val(const long double &a)
-{
-    return isfinite(a);
-}
-
-/// Predicate for comparing tokens.
-bool eq(const long double &a, const long double &b)
-{
+#ifndef ABSOLUTE_TOLERANCE
     // An error of 0.00001 is allowed. (Due to six digit printing of floats.)
-    if (a - b <= 0.00001L && b - a <= 0.00001L)
-    {
-        return true;
-    }
+    #define ABSOLUTE_TOLERANCE 0.00001L
+#endif
 
+#ifndef RELATIVE_TOLERANCE
     // An error of 1% allowed.
-    if (a >= 0.0L)
-    {
-        return a * 0.99L <= b && b <= a * 1.01L;
-    }
-    else
-    {
-        return a * 1.01L <= b && b <= a * 0.99L;
-    }
-}
+    #define RELATIVE_TOLERANCE 0.01L
+#endif
 
 #ifdef SHOW_DIFF
     #define SHOW_DIFF_FLAG true
@@ -54,11 +47,38 @@ bool eq(const long double &a, const long double &b)
     #define SHOW_OUTPUT_FLAG false
 #endif
 
+#ifdef STREAM_INPUT
+    #define INPUT_TYPE StreamInput
+#else
+    #define INPUT_TYPE ByteInput
+#endif
+
+#ifdef BATCHED_COMPARE
+    #define BATCHED_COMPARE_FLAG true
+#else
+    #define BATCHED_COMPARE_FLAG false
+#endif
+
+#ifndef CHECKER_THREADS
+    #define CHECKER_THREADS 1
+#endif
+
 /// Implements the program. See the documentation of diff_checker_real.cpp.
 int main(int argc, char **argv)
 {
-    return diff_checker_base<Tokenizer<long double, val, eq>,
+    DiffCheckerOptions<RealTokenizer<INPUT_TYPE>> options;
+
+    options.equal = ToleranceEqual<long double>(ABSOLUTE_TOLERANCE,
+                                                RELATIVE_TOLERANCE);
+    options.toleranceSuffix = ToleranceSuffix;
+    options.threads = CHECKER_THREADS;
+    options.digestSuffix = RealDigestSuffix;
+    options.compiledSuffix = RealCompiledSuffix;
+
+    return diff_checker_base<RealTokenizer<INPUT_TYPE>,
                              3,
                              SHOW_DIFF_FLAG,
-                             SHOW_OUTPUT_FLAG>(argc, argv);
+                             SHOW_OUTPUT_FLAG,
+                             false, // Do not skip the equal prefix.
+                             BATCHED_COMPARE_FLAG>(argc, argv, options);
 }
@@ -0,0 +1,277 @@
+// Author: Hakan Yıldız
+// Shared under MIT License. See the file LICENSE for more info.
+
+/// @file diff_checker_word.cpp
+/// Implements a checker program with the parameters and the output format in
+/// diff_checker_base.ipp, with the following properties:
+/// - The files are compared line by line, where a line is a sequence of words
+///   delimited by whitespace. (See WordLines.)
+/// - The grade ratio is the number of lines in the longest common subsequence
+///   of the lines of the files, over the number of lines of the longer one,
+///   rounded down to four decimals. (See longestCommonSubsequence.) Thus, an
+///   output with a line missing or a line too many still gets partial credit.
+/// - The SHOW_DIFF and SHOW_OUTPUT macros determine whether the first mismatch
+///   and the output up to its line should be shown.
+/// - The files are memory-mapped, and the words are compared in place. A file
+///   that cannot be mapped (e.g., a pipe) is read as a whole first.
+
+#include <cmath>
+#include <cstdio>
+
+#include "diff_checker_base.ipp"
+#include "LineDiff.ipp"
+
+#ifdef SHOW_DIFF
+    #define SHOW_DIFF_FLAG true
+#else
+    #define SHOW_DIFF_FLAG false
+#endif
+
+#ifdef SHOW_OUTPUT
+    #define SHOW_OUTPUT_FLAG true
+#else
+    #define SHOW_OUTPUT_FLAG false
+#endif
+
+/// Returns the long string of a word of a line, as Token::lstr() returns it, or
+/// of the end of the line if the line has no more words.
+/// @param lines The lines.
+/// @param line  The index of the line, from 0.
+/// @param word  The index of the word within the line, from 0.
+string wordLstr(const WordLines &lines, size_t line, size_t word)
+{
+    if (line >= lines.lines())
+    {
+        return "<end>";
+    }
+    else if (word >= lines.words(line))
+    {
+        return line + 1 == lines.lines() ? "<end>" : "<newline>";
+    }
+    else
+    {
+        string result(1, '\'');
+        result.append(lines.word(line, word));
+        result.push_back('\'');
+        return result;
+    }
+}
+
+/// Checks a single test case. See documentation of diff_checker_word.cpp.
+/// @tparam ShowDiff   Whether to show the first mismatch.
+/// @tparam ShowOutput Whether to show <claimed_output_file> up to the line of
+///                    the first mismatch.
+/// @param claimedOutputPath The <claimed_output_file> parameter.
+/// @param correctOutputPath The <correct_output_file> parameter.
+/// @param hidden            The <hidden> parameter.
+/// @param output            The buffer to write the output to.
+/// @return The exit code of the checker for the test case.
+template<bool ShowDiff, bool ShowOutput>
+int diff_checker_word_case(const char *claimedOutputPath,
+                           const char *correctOutputPath,
+                           const string &hidden,
+                           OutputBuffer &output)
+{
+    if (hidden != "0" && hidden != "1")
+    {
+        cerr << "Invalid test-case-hidden parameter." << endl;
+        return 1;
+    }
+
+    const bool isTestCaseHidden = (hidden == "1");
+
+    ByteInput claimedInput(claimedOutputPath);
+
+    if (claimedInput.fail())
+    {
+        output << "0|Error opening the output file." << '\n';
+        return 0;
+    }
+
+    ByteInput correctInput(correctOutputPath);
+
+    if (correctInput.fail())
+    {
+        cerr << "Error opening the ground-truth file." << endl;
+        return 1;
+    }
+
+    claimedInput.readToEnd();
+    correctInput.readToEnd();
+
+    CheckerStatsTimer parseTimer(checkerStats.parseNanoseconds);
+    WordLines claimed(claimedInput.position(),
+                      claimedInput.position() + claimedInput.available());
+    WordLines correct(correctInput.position(),
+                      correctInput.position() + correctInput.available());
+
+    parseTimer.stop();
+
+    if (!correct.isValid())
+    {
+        cerr << "Ground-truth file format is invalid." << endl;
+        return 1;
+    }
+
+    // The first line that differs, and the first word that differs in it.
+    size_t line = 0;
+    size_t word = 0;
+
+    while (line < claimed.lines() && line < correct.lines() &&
+           claimed.isEqual(line, correct, line))
+    {
+        line++;
+    }
+
+    if (line == claimed.lines() && line == correct.lines() && claimed.isValid())
+    {
+        output << "1|Correct output.";
+        return 0;
+    }
+
+    while (line < claimed.lines() && line < correct.lines() &&
+           word < claimed.words(line) && word < correct.words(line) &&
+           claimed.word(line, word) == correct.word(line, word))
+    {
+        word++;
+    }
+
+    // An invalid character is reported after the words of its line, which is
+    // the last one, if the lines before it match.
+    const bool isInvalid = !claimed.isValid() && line + 1 >= claimed.lines();
+
+    if (isInvalid)
+    {
+        line = claimed.lines() - 1;
+        word = claimed.words(line);
+    }
+
+    // An output with an invalid character gets no partial credit.
+    double ratio = 0;
+    size_t common = 0;
+    size_t total = std::max(claimed.lines(), correct.lines());
+
+    if (claimed.isValid())
+    {
+        LineInterner interner(claimed.lines() + correct.lines());
+        vector<uint32_t> claimedIds(claimed.lines());
+        vector<uint32_t> correctIds(correct.lines());
+
+        for (size_t i = 0; i < correct.lines(); i++)
+        {
+            correctIds[i] = interner.intern(correct, i);
+        }
+
+        for (size_t i = 0; i < claimed.lines(); i++)
+        {
+            claimedIds[i] = interner.intern(claimed, i);
+        }
+
+        common = longestCommonSubsequence(correctIds.data(), correctIds.size(),
+                                          claimedIds.data(), claimedIds.size(),
+                                          interner.size());
+        ratio = std::floor(10000.0 * static_cast<double>(common) /
+                           static_cast<double>(total)) / 10000.0;
+    }
+
+    CheckerStatsTimer outputTimer(checkerStats.outputNanoseconds);
+    char ratioText[16];
+
+    std::snprintf(ratioText, sizeof(ratioText), "%.4f", ratio);
+
+    if constexpr (ShowDiff)
+    {
+        if (isTestCaseHidden)
+        {
+            output << ratioText << "|Wrong output. (Mismatch intentionally hidden.)" << '\n';
+        }
+        else
+        {
+            output << ratioText
+                 << "|Unexpected "
+                 << (isInvalid ? "<invalid-format>" : wordLstr(claimed, line, word))
+                 << " at line "
+                 << line + 1
+                 << ", token "
+                 << word + 1
+                 << ", while expecting "
+                 << wordLstr(correct, line, word)
+                 << ".";
+
+            if (claimed.isValid())
+            {
+                output << " (" << common << " of " << total << " lines match.)";
+            }
+            else if (!isInvalid)
+            {
+                // The invalid character comes after the mismatch, and is the
+                // reason for the lack of partial credit.
+                output << " (Your output has an invalid character at line "
+                       << claimed.lines() << ", so no partial credit is given.)";
+            }
+
+            output << '\n';
+        }
+    }
+    else
+    {
+        output << ratioText << "|Wrong output." << '\n';
+    }
+
+    if constexpr (ShowOutput)
+    {
+        if (isTestCaseHidden)
+        {
+            output << "(Your output is intentionally hidden.)" << '\n';
+        }
+        else
+        {
+            output << "Your output (as parsed):" << '\n';
+
+            // Only the tail of the output up to the mismatch is shown.
+            TailBuffer checkerOutput(ShownOutputLines, ShownOutputBytes);
+            size_t shown = std::min(line + 1, claimed.lines());
+
+            for (size_t i = 0; i < shown; i++)
+            {
+                for (size_t j = 0; j < claimed.words(i); j++)
+                {
+                    if (j > 0)
+                    {
+                        checkerOutput.append(' ');
+                    }
+
+                    checkerOutput.append(claimed.word(i, j).data(),
+                                         claimed.word(i, j).size());
+                }
+
+                if (i + 1 < shown)
+                {
+                    checkerOutput.append('\n');
+                }
+            }
+
+            output << checkerOutput.str(".....");
+
+            if (isInvalid)
+            {
+                output << "..?..";
+            }
+            else if (shown < claimed.lines())
+            {
+                output << "\n.....";
+            }
+
+            output << '\n';
+        }
+    }
+
+    return 0;
+}
+
+/// Implements the program. See the documentation of diff_checker_word.cpp.
+int main(int argc, char **argv)
+{
+    return diff_checker_main(argc, argv, diff_checker_word_case<SHOW_DIFF_FLAG,
+                                                                SHOW_OUTPUT_FLAG>);
+}
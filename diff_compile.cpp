@@ -0,0 +1,97 @@
+// Author: Hakan Yıldız
+// Shared under MIT License. See the file LICENSE for more info.
+
+/// @file diff_compile.cpp
+/// Implements a program that writes the compiled files of correct output files
+/// (see CompiledOutput.ipp), from which the checkers read the tokens of the
+/// ground truth without parsing it. It is meant to be run once, offline, after
+/// the test cases are prepared, and again whenever they change.
+///
+/// Usage:
+///     diff_compile <char|real> <correct_output_file>...
+///
+/// The first parameter names the checker, i.e., diff_checker_char.cpp or
+/// diff_checker_real.cpp, whose tokenizer reads the files. The compiled file of
+/// each <correct_output_file> is written next to it. The program exits with 0
+/// if all the compiled files were written, and with 1 otherwise.
+
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "CompiledOutput.ipp"
+#include "Digest.ipp"
+#include "Tokenizer.ipp"
+
+using std::cerr;
+using std::endl;
+using std::string;
+
+/// Writes the compiled file of a correct output file.
+/// @tparam Tokenizer The tokenizer of the checker.
+/// @param path The path of the correct output file.
+/// @param suffix The suffix of the compiled file.
+/// @return Whether the compiled file was written.
+template<typename Tokenizer>
+bool compileFile(const char *path, const char *suffix)
+{
+    // The stamp is taken first, so that a change while the file is read makes
+    // the checkers compare the raw digest instead.
+    FileStamp stamp;
+    ByteInput input(path);
+
+    if (!stamp.read(path) || input.fail() || !input.isContiguous())
+    {
+        cerr << path << ": Error opening the ground-truth file." << endl;
+        return false;
+    }
+
+    Digest raw;
+
+    raw.append(input.position(), input.available());
+
+    Tokenizer tokenizer(input);
+    int result = writeCompiledFile(tokenizer, raw.hex(), stamp, path + string(suffix));
+
+    if (result == 0)
+    {
+        cerr << path << ": Ground-truth file format is invalid." << endl;
+    }
+    else if (result < 0)
+    {
+        cerr << path << ": Error writing the compiled file." << endl;
+    }
+
+    return result > 0;
+}
+
+/// Implements the program. See the documentation of diff_compile.cpp.
+int main(int argc, char **argv)
+{
+    bool isChar = (argc >= 2 && std::strcmp(argv[1], "char") == 0);
+    bool isReal = (argc >= 2 && std::strcmp(argv[1], "real") == 0);
+
+    if (argc < 3 || (!isChar && !isReal))
+    {
+        cerr << "Invalid parameters." << endl;
+        return 1;
+    }
+
+    bool success = true;
+
+    for (int i = 2; i < argc; i++)
+    {
+        if (isChar)
+        {
+            success &= compileFile<CharTokenizer<ByteInput>>(argv[i],
+                                                             CharCompiledSuffix);
+        }
+        else
+        {
+            success &= compileFile<RealTokenizer<ByteInput>>(argv[i],
+                                                             RealCompiledSuffix);
+        }
+    }
+
+    return success ? 0 : 1;
+}
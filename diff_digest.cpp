@@ -0,0 +1,102 @@
+// Author: Hakan Yıldız
+// Shared under MIT License. See the file LICENSE for more info.
+
+/// @file diff_digest.cpp
+/// Implements a program that writes the digest files of correct output files
+/// (see Digest.ipp), with which the checkers accept equal claimed outputs in a
+/// single pass. It is meant to be run once, offline, after the test cases are
+/// prepared, and again whenever they change.
+///
+/// Usage:
+///     diff_digest <char|real> <correct_output_file>...
+///
+/// The first parameter names the checker, i.e., diff_checker_char.cpp or
+/// diff_checker_real.cpp, whose tokenizer reads the files. The digest file of
+/// each <correct_output_file> is written next to it. The program exits with 0
+/// if all the digest files were written, and with 1 otherwise.
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "Digest.ipp"
+#include "Tokenizer.ipp"
+
+using std::cerr;
+using std::endl;
+using std::ofstream;
+using std::string;
+
+/// Writes the digest file of a correct output file.
+/// @tparam Tokenizer The tokenizer of the checker.
+/// @param path The path of the correct output file.
+/// @param suffix The suffix of the digest file.
+/// @return Whether the digest file was written.
+template<typename Tokenizer>
+bool writeDigestFile(const char *path, const char *suffix)
+{
+    ByteInput input(path);
+
+    if (input.fail() || !input.isContiguous())
+    {
+        cerr << path << ": Error opening the ground-truth file." << endl;
+        return false;
+    }
+
+    Digest raw;
+    Digest canonical;
+
+    raw.append(input.position(), input.available());
+
+    Tokenizer tokenizer(input);
+
+    if (!appendCanonicalTokens(tokenizer, canonical))
+    {
+        cerr << path << ": Ground-truth file format is invalid." << endl;
+        return false;
+    }
+
+    ofstream file(path + string(suffix));
+
+    file << canonical.hex() << " " << raw.hex() << "\n";
+
+    if (!file.flush())
+    {
+        cerr << path << ": Error writing the digest file." << endl;
+        return false;
+    }
+
+    return true;
+}
+
+/// Implements the program. See the documentation of diff_digest.cpp.
+int main(int argc, char **argv)
+{
+    bool isChar = (argc >= 2 && std::strcmp(argv[1], "char") == 0);
+    bool isReal = (argc >= 2 && std::strcmp(argv[1], "real") == 0);
+
+    if (argc < 3 || (!isChar && !isReal))
+    {
+        cerr << "Invalid parameters." << endl;
+        return 1;
+    }
+
+    bool success = true;
+
+    for (int i = 2; i < argc; i++)
+    {
+        if (isChar)
+        {
+            success &= writeDigestFile<CharTokenizer<ByteInput>>(argv[i],
+                                                                 CharDigestSuffix);
+        }
+        else
+        {
+            success &= writeDigestFile<RealTokenizer<ByteInput>>(argv[i],
+                                                                 RealDigestSuffix);
+        }
+    }
+
+    return success ? 0 : 1;
+}
@@ -20,19 +20,34 @@
 # IMPORTS #
 ###########
 
+from codecs import getincrementaldecoder
+from concurrent.futures import ThreadPoolExecutor
+from contextlib import nullcontext
 from enum import Enum
-from glob import glob
-from multiprocessing import Process, Queue
-from os import chmod, remove
-from os.path import exists
-from resource import RLIMIT_AS, RLIMIT_STACK, setrlimit
+from glob import escape as escapeGlob, glob
+from hashlib import sha256
+from io import StringIO
+from json import dump, dumps, load, loads
+from os import chmod, close as closeDescriptor, getpid, kill, makedirs, mkfifo, \
+               fstat, open as openDescriptor, O_NONBLOCK, O_RDONLY, pread, read, remove, replace, \
+               sched_getaffinity, symlink, sysconf, wait4, waitstatus_to_exitcode, WNOHANG
+from os.path import abspath, dirname, exists, getsize, isdir, join, lexists, relpath
+from queue import SimpleQueue
+from re import compile as compileRegex
+from math import ceil
+from resource import getrusage, RUSAGE_SELF, struct_rusage
+from select import select
 from shutil import copyfile
-from signal import strsignal
+from signal import SIGKILL, SIGXFSZ, strsignal
 from stat import S_IXUSR, S_IRUSR
-from subprocess import check_output, STDOUT, TimeoutExpired, CalledProcessError
-from time import time
+from struct import calcsize, unpack
+from subprocess import check_output, PIPE, Popen, STDOUT, TimeoutExpired, CalledProcessError
+from sys import argv, stdout
+from tempfile import TemporaryFile
+from threading import Event, get_ident, Thread
+from time import sleep, time
 from traceback import format_exc
-from typing import Optional, List, Literal
+from typing import BinaryIO, Dict, Optional, List, Literal, TextIO, Tuple, Union
 
 
 #################
@@ -42,15 +57,29 @@ from typing import Optional, List, Literal
 # The total grade for the task. Divided evenly among the available inputs.
 TOTAL_GRADE : float = 100
 
-# The time limit in seconds for each test run.
+# The time limit in seconds for each test run. This is measured as CPU time (user + system), so that
+# test runs competing for the cores (see PARALLEL_WORKERS) do not exceed it falsely.
 TIME_LIMIT_IN_SECONDS : float = 1.0
 
+# The limit in seconds for the real (wall-clock) time of each test run, which is needed to stop test
+# runs that wait without using CPU time.
+WALL_TIME_LIMIT_IN_SECONDS : float = 4 * TIME_LIMIT_IN_SECONDS
+
+# The number of test cases to run in parallel, or 0 for all the cores available to this process. Note
+# that each parallel test run may use up to MEMORY_LIMIT_IN_MBS, and a core of its own.
+PARALLEL_WORKERS : int = 1
+
 # Memory limit in MBs.
 MEMORY_LIMIT_IN_MBS : int = 256
 
 # Stack limit in MBs.
 STACK_LIMIT_IN_MBS : int = 8
 
+# The limit in MBs for the output of each test run, or None for no limit. The test subject writes
+# its output directly into the output file (see OUTPUT_FILE), and the kernel stops it if the file
+# grows beyond this.
+OUTPUT_LIMIT_IN_MBS : Optional[int] = None
+
 # The source files to compile to get the test subject, which is the program to be graded. If
 # COMPILER is given as "python3", this should contain a single python file.
 SOURCE_FILES : List[str] = ["homework.c"]
@@ -64,12 +93,38 @@ COMPILER_FLAGS : List[str] = ["-g", "-std=c17", "-w"]
 # The time limit (in seconds) for the compilation.
 COMPILER_TIMEOUT : float = 1.0
 
+# The instructor-provided translation units among SOURCE_FILES, which are compiled into objects once
+# and linked into all submissions (see COMPILATION_CACHE_DIRECTORY).
+SHARED_SOURCE_FILES : List[str] = []
+
+# The instructor-provided headers included by SOURCE_FILES, which are precompiled once and used by
+# the compilation of all submissions (see COMPILATION_CACHE_DIRECTORY).
+SHARED_HEADER_FILES : List[str] = []
+
+# The directory in which the objects of SHARED_SOURCE_FILES and the precompiled SHARED_HEADER_FILES
+# are cached across grading runs, or None to compile all of SOURCE_FILES in every run. A cached file
+# is keyed by the contents of its source (and the local headers it includes), COMPILER_FLAGS and the
+# compiler version, like the checker (see CHECKER_CACHE_DIRECTORY), so that a submission that changes
+# one of them is compiled as a whole. Only the rest of the compilation is then limited by
+# COMPILER_TIMEOUT, which makes it depend on the size of the student's own code. [WARNING] The test
+# subjects must not be able to write into this directory. Otherwise, a submission can replace the
+# objects for the upcoming grading runs.
+COMPILATION_CACHE_DIRECTORY : Optional[str] = None
+
 # The name of the executable file for the test subject.
 EXECUTABLE_NAME : str = "StudentsSubmission"
 
-# The file to which the test subject's output is forwarded.
+# The file to which the test subject's output is forwarded. When test cases run in parallel, each
+# worker uses this name followed by its index.
 OUTPUT_FILE : str = "StudentsOutput"
 
+# Whether the output of the test subject is streamed to the checker while the test subject runs,
+# instead of being checked after it exits. The output file (see OUTPUT_FILE) is then a FIFO, which
+# the checker reads as the output is produced, and the test subject is stopped as soon as the checker
+# finds the output wrong. OUTPUT_LIMIT_IN_MBS does not apply then. The checker must read
+# <claimedOutput> sequentially (see below), as the provided diff checkers do.
+STREAM_TO_CHECKER : bool = False
+
 # The source files for the checker. If CHECKER_COMPILER is given as "python3", this should contain a
 # single python file. The checker is a program that receives four command line arguments:
 #     <input>: The input file against which the test subject is run.
@@ -92,12 +147,65 @@ CHECKER_COMPILER_FLAGS : List[str] = ["-std=c++2a", "-w", "-O3", "-DSHOW_DIFF",
 # The time limit (in seconds) given for the compilation of the checker.
 CHECKER_COMPILER_TIMEOUT : float = 1.0
 
+# The directory in which compiled checkers are cached across grading runs, or None to compile the
+# checker in every run. A cached checker is keyed by the contents of CHECKER_SOURCE_FILES (and the
+# local headers they include), CHECKER_COMPILER_FLAGS and the compiler version, so that it is only
+# compiled when one of them changes. [WARNING] The test subjects must not be able to write into this
+# directory. Otherwise, a submission can replace the checker for the upcoming grading runs.
+CHECKER_CACHE_DIRECTORY : Optional[str] = None
+
+# The directory in which the results of the test cases are cached across grading runs, or None to run
+# every test case in every run. A cached result is keyed by the submission (i.e., the contents of
+# SOURCE_FILES and the local headers they include, COMPILER_FLAGS and the compiler version), the
+# input and output files of the test case (and the files named after the output file followed by a
+# '.', e.g., its tolerance file), the checker executable and the limits, so that a regrade only runs
+# the test cases affected by a change, e.g., of an output file. Only the results of the test runs that
+# exit by themselves within their limits are cached, and not those of timed out, killed or stopped
+# test runs or failed checker runs, which may depend on the load of the machine. [WARNING] The test
+# subjects must not be able to write into this directory. Otherwise, a submission can plant results
+# for the upcoming grading runs.
+RESULT_CACHE_DIRECTORY : Optional[str] = None
+
 # The time limit (in seconds) for the checker itself, excluding the run of the test subject.
 CHECKER_TIMEOUT : float = 1.0
 
 # The name of the executable to produce.
 CHECKER_EXECUTABLE_NAME : str = "Checker"
 
+# Further checkers, which the test cases can choose by name in TEST_CASES_FILE, each given by its
+# source files and its flags. They are compiled like the checker (see CHECKER_SOURCE_FILES), which is
+# named "default", but only if a test case uses them. For instance:
+#     {"real" : (["diff_checker_real.cpp"], ["-std=c++2a", "-w", "-O3", "-DSHOW_DIFF"])}
+NAMED_CHECKERS : Dict[str, Tuple[List[str], List[str]]] = {}
+
+# The file to which the counters of the checker are appended (as a JSON line per grading run), so
+# that they can be aggregated across submissions, or None to only report them per test case. The
+# provided diff checkers write their counters if compiled with "-DCHECKER_STATS" among
+# CHECKER_COMPILER_FLAGS (see CheckerStats.ipp), and cost nothing otherwise.
+CHECKER_STATS_FILE : Optional[str] = None
+
+# Whether the checker is started once to serve all test cases, instead of once per test case. The
+# provided diff checkers support this via their "--server" parameter (see diff_checker_base.ipp).
+# Other checkers may not support it, so it is off by default.
+CHECKER_SERVER : bool = False
+
+# Whether the checker server (see CHECKER_SERVER) is started with "--binary-server" instead, in which
+# case it gives the grade ratio of each test case in a binary header rather than as text, so that the
+# grade is read without parsing the further output. The provided diff checkers support this (see
+# diff_checker_base.ipp). Other checkers may only support "--server", so it is off by default.
+CHECKER_SERVER_BINARY : bool = False
+
+# The file that lists the test cases, or None to always find them by INPUT_SUFFIX (see below). The file
+# is used if it lists any test case, one per line, as follows:
+#     <name> [weight=<weight>] [time=<seconds>] [memory=<MBs>] [checker=<name>]
+# where <name> is the name of the input file without INPUT_SUFFIX. The grade of a test case is its
+# share of TOTAL_GRADE by weight (1 by default). The time sets TIME_LIMIT_IN_SECONDS for the test
+# case, and WALL_TIME_LIMIT_IN_SECONDS in proportion, the memory sets MEMORY_LIMIT_IN_MBS and the
+# checker is one of NAMED_CHECKERS. Empty lines and the text following a '#' are ignored. The test
+# cases are reported in the order they are listed in, but they are run from the longest one (by its
+# time limit, and then by its input size), so that no worker runs a long one while the others idle.
+TEST_CASES_FILE : Optional[str] = "vpl_evaluate.cases"
+
 # Suffix for the input files. All files with this suffix is considered to be an input and therefore
 # present a test case. The file name prior to the suffix is considered to be the label for the test
 # case.
@@ -110,6 +218,11 @@ OUTPUT_SUFFIX : str = ".out"
 # Whether we show the input/output contents prior to running each test case.
 SHOW_INPUT_OUTPUT : bool = True
 
+# The number of bytes of each input/output file shown when SHOW_INPUT_OUTPUT is true, or None to show
+# them in full. Only so many bytes are read from a larger file, and a notice with the number of bytes
+# omitted follows them.
+SHOWN_INPUT_OUTPUT_BYTES : Optional[int] = 8192
+
 # Test cases with inputs that bear this suffix (prior to their INPUT_SUFFIX) are considered to be
 # hidden. Setting SHOW_INPUT_OUTPUT as true does not apply to hidden test cases: Their input/output
 # would remain hidden. The hidden status of a test case is also specified to the checker via its
@@ -117,41 +230,335 @@ SHOW_INPUT_OUTPUT : bool = True
 # test case. Finally, note that this suffix itself is removed from the label for the test case.
 HIDDEN_SUFFIX : Optional[str] = "hidden"
 
+# The file into which the report of each submission is written, in its directory, when the script is
+# run as "vpl_evaluate.sh --batch <directory>...", e.g., for a bulk regrade. The submissions are then
+# graded in one process against the test cases in the current directory (see gradeBatch): The
+# SOURCE_FILES of each one are taken from its directory, where its vpl_execution is written, and only
+# a line with its grade is printed.
+BATCH_REPORT_FILE : str = "vpl_evaluate.report"
+
 
 ########
 # CODE #
 ########
 
-def printFormatted(msg : str):
+def printFormatted(msg : str, *, file : Optional[TextIO] = None):
     """Prints a string with necessary formatting so that it is pretty in the VPL output."""
-    print(msg)
+    print(msg, file = file)
     # TODO: Formatted print looking nice both on "Edit" and "View Submission" modes.
     # for line in msg.split("\n"):
     #     print(">" + line)
 
+def limitedCommand(command : List[str],
+                   *,
+                   cpuTimeLimitInSeconds : Optional[float],
+                   memoryLimitInMbs : Optional[int],
+                   stackLimitInMbs : Optional[int],
+                   outputLimitInMbs : Optional[int]) -> List[str]:
+    """
+    Returns a command that runs the given one under the given resource limits. The limits are set by
+    a shell that then replaces itself with the program, so that neither this process gets the limits
+    nor Python code runs between fork and exec (i.e., a preexec_fn), which is unsafe in the presence
+    of threads and rules out the faster vfork() in subprocess.
+    """
+    limits : List[str] = []
+    if memoryLimitInMbs is not None:
+        limits.append(f"ulimit -v {memoryLimitInMbs * 1024}")
+    if stackLimitInMbs is not None:
+        limits.append(f"ulimit -s {stackLimitInMbs * 1024}")
+    if outputLimitInMbs is not None:
+        # The file size limit is given in blocks of 512 bytes.
+        limits.append(f"ulimit -f {outputLimitInMbs * 2048}")
+    if cpuTimeLimitInSeconds is not None:
+        # The kernel stops CPU-bound runs early, without waiting for the real time limit.
+        limits.append(f"ulimit -t {ceil(cpuTimeLimitInSeconds) + 1}")
+    if len(limits) == 0:
+        return command
+    return ["/bin/sh", "-c", " && ".join(limits + ['exec "$0" "$@"'])] + command
+
+def waitWithDeadline(process : Popen,
+                     *,
+                     deadline : float,
+                     stop : Optional[Event] = None) -> Tuple[int, struct_rusage, bool]:
+    """
+    Reaps the given process with wait4(), killing it if it is still running at the deadline or when
+    the given event is set. Returns the wait status, the resource usage of the process and whether it
+    was killed, rather than exiting by itself meanwhile.
+    """
+    delay = 0.0005
+    while True:
+        pid, status, usage = wait4(process.pid, WNOHANG)
+        if pid != 0:
+            return status, usage, False
+        remainingTime = deadline - time()
+        if remainingTime <= 0 or (stop is not None and stop.is_set()):
+            # Popen.kill() may reap the process itself, losing its resource usage.
+            kill(process.pid, SIGKILL)
+            _, status, usage = wait4(process.pid, 0)
+            return status, usage, waitstatus_to_exitcode(status) == -SIGKILL
+        if stop is None:
+            sleep(min(delay, remainingTime))
+        else:
+            stop.wait(min(delay, remainingTime))
+        delay = min(2 * delay, 0.05)
+
+def inDirectory(directory : str, path : str) -> str:
+    """
+    Returns a path given relative to a submission directory (see gradeBatch) as a path relative to
+    the current directory, which is the very path for the current directory itself.
+    """
+    return path if directory == "." else join(directory, path)
+
+INCLUDE_PATTERN = compileRegex(r'^\s*#\s*include\s*"([^"]+)"')
+
+def localSourceFiles(sources : List[str]) -> List[str]:
+    """Returns the given source files and the local headers (i.e., #include "...") they include."""
+    found : List[str] = []
+    pending = list(sources)
+    while len(pending) > 0:
+        source = pending.pop()
+        if source in found or not exists(source):
+            continue
+        found.append(source)
+        with open(source, "r", encoding = "utf-8", errors = "replace") as stream:
+            for line in stream:
+                match = INCLUDE_PATTERN.match(line)
+                if match is not None:
+                    pending.append(join(dirname(source), match.group(1)))
+    return sorted(found)
+
+def sourcesDigest(*,
+                  sources : List[str],
+                  compiler : str,
+                  flags : List[str],
+                  directory : str = ".") -> str:
+    """
+    Returns the SHA-256 of the given sources, the local headers they include, the compiler version
+    and the flags. The sources are given relative to the given directory, and the digest does not
+    depend on it. Raises OSError or CalledProcessError if they cannot be read.
+    """
+    digest = sha256()
+    digest.update(check_output([compiler, "--version"], stderr = STDOUT))
+    for flag in flags:
+        digest.update(b"flag\0" + flag.encode("utf-8") + b"\0")
+    for source in localSourceFiles([inDirectory(directory, source) for source in sources]):
+        with open(source, "rb") as stream:
+            content = stream.read()
+        name = source if directory == "." else relpath(source, directory)
+        digest.update(b"file\0" + name.encode("utf-8") + b"\0" +
+                      str(len(content)).encode("utf-8") + b"\0" + content)
+    return digest.hexdigest()
+
+def cachedExecutablePath(*,
+                         cacheDirectory : str,
+                         name : str,
+                         sources : List[str],
+                         compiler : str,
+                         flags : List[str],
+                         directory : str = ".") -> Optional[str]:
+    """
+    Returns the path for an executable in the cache directory, keyed by the given sources (relative
+    to the given directory), the local headers they include, the compiler version and the flags.
+    Returns None if the cache is unusable.
+    """
+    try:
+        digest = sourcesDigest(sources = sources, compiler = compiler, flags = flags,
+                               directory = directory)
+        makedirs(cacheDirectory, exist_ok = True)
+        return abspath(join(cacheDirectory, f"{name}-{digest}"))
+    except (OSError, CalledProcessError):
+        return None
+
+def cachedSharedPart(*,
+                     cacheDirectory : str,
+                     source : str,
+                     compiler : Literal["gcc", "g++"],
+                     flags : List[str],
+                     isHeader : bool,
+                     compilationTimeout : float,
+                     directory : str = ".") -> Optional[str]:
+    """
+    Returns the path of the object of a translation unit, or of a precompiled header, in the cache
+    directory, compiling it first if it is not cached (see COMPILATION_CACHE_DIRECTORY). The source is
+    given relative to the given directory, in which it is compiled. Returns None if it cannot be
+    compiled, in which case the source is to be compiled along with the rest.
+    """
+    if isHeader:
+        mode = ["-x", "c++-header" if compiler == "g++" else "c-header"]
+    else:
+        mode = ["-c"]
+    cachedFile = cachedExecutablePath(cacheDirectory = cacheDirectory,
+                                      name = "Header" if isHeader else "Object",
+                                      sources = [source],
+                                      compiler = compiler,
+                                      flags = mode + flags,
+                                      directory = directory)
+    if cachedFile is None or exists(cachedFile):
+        return cachedFile
+    # Compile into a temporary file in the cache, which is then renamed atomically.
+    outputFile = f"{cachedFile}.{getpid()}.tmp"
+    try:
+        check_output([compiler] + mode + [source, "-o", outputFile] + flags,
+                     stderr = STDOUT,
+                     timeout = compilationTimeout,
+                     cwd = directory)
+        replace(outputFile, cachedFile)
+        return cachedFile
+    except (OSError, CalledProcessError, TimeoutExpired):
+        return None
+    finally:
+        if exists(outputFile):
+            remove(outputFile)
+
 class ExecuteResultStatus(Enum):
     """Represents the result status of a program execution."""
     Success = 0
     NonZeroExitCode = 1
     TimeLimitExceeded = 2
     CompilationFailed = 3
+    OutputLimitExceeded = 4
+    Stopped = 5
+
+class ResourceUsage:
+    """
+    Represents the resources used by a program execution, as reported by wait4() (see getrusage())
+    or, for a process that is still running, by /proc.
+    """
+    _userTimeInSeconds : float
+    _systemTimeInSeconds : float
+    _maxResidentSetInKbs : int
+    _maxResidentSetIsExact : bool
+    _minorPageFaults : int
+    _majorPageFaults : int
+    _voluntaryContextSwitches : int
+    _involuntaryContextSwitches : int
+    #
+    def __init__(self, *,
+                 userTimeInSeconds : float,
+                 systemTimeInSeconds : float,
+                 maxResidentSetInKbs : int,
+                 maxResidentSetIsExact : bool,
+                 minorPageFaults : int,
+                 majorPageFaults : int,
+                 voluntaryContextSwitches : int,
+                 involuntaryContextSwitches : int):
+        self._userTimeInSeconds = userTimeInSeconds
+        self._systemTimeInSeconds = systemTimeInSeconds
+        self._maxResidentSetInKbs = maxResidentSetInKbs
+        self._maxResidentSetIsExact = maxResidentSetIsExact
+        self._minorPageFaults = minorPageFaults
+        self._majorPageFaults = majorPageFaults
+        self._voluntaryContextSwitches = voluntaryContextSwitches
+        self._involuntaryContextSwitches = involuntaryContextSwitches
+    #
+    @staticmethod
+    def fromRusage(usage : struct_rusage, *, inheritedMaxResidentSetInKbs : int) -> "ResourceUsage":
+        """
+        Returns the resource usage reported by wait4() for a child process. The kernel counts the
+        peak of the memory that the child shared with this process until it called exec() in the max
+        resident set size, so the given peak of this process makes it only an upper bound.
+        """
+        return ResourceUsage(userTimeInSeconds = usage.ru_utime,
+                             systemTimeInSeconds = usage.ru_stime,
+                             maxResidentSetInKbs = usage.ru_maxrss,
+                             maxResidentSetIsExact = usage.ru_maxrss > inheritedMaxResidentSetInKbs,
+                             minorPageFaults = usage.ru_minflt,
+                             majorPageFaults = usage.ru_majflt,
+                             voluntaryContextSwitches = usage.ru_nvcsw,
+                             involuntaryContextSwitches = usage.ru_nivcsw)
+    #
+    @staticmethod
+    def ofRunningProcess(pid : int) -> Optional["ResourceUsage"]:
+        """
+        Returns the resource usage of a running child process so far, read from /proc, or None if
+        that is not available. The CPU time has the resolution of the clock ticks.
+        """
+        try:
+            with open(f"/proc/{pid}/stat", "r", encoding = "utf-8") as stream:
+                # The fields following the parenthesized command name, starting with the 3rd one.
+                stat = stream.read().rsplit(")", maxsplit = 1)[1].split()
+            with open(f"/proc/{pid}/status", "r", encoding = "utf-8") as stream:
+                status = dict(line.split(":", maxsplit = 1) for line in stream if ":" in line)
+            ticksPerSecond = sysconf("SC_CLK_TCK")
+            return ResourceUsage(userTimeInSeconds = int(stat[11]) / ticksPerSecond,
+                                 systemTimeInSeconds = int(stat[12]) / ticksPerSecond,
+                                 maxResidentSetInKbs = int(status["VmHWM"].split()[0]),
+                                 maxResidentSetIsExact = True,
+                                 minorPageFaults = int(stat[7]),
+                                 majorPageFaults = int(stat[9]),
+                                 voluntaryContextSwitches = int(status["voluntary_ctxt_switches"]),
+                                 involuntaryContextSwitches =
+                                     int(status["nonvoluntary_ctxt_switches"]))
+        except (OSError, IndexError, KeyError, ValueError):
+            return None
+    #
+    def since(self, earlier : "ResourceUsage") -> "ResourceUsage":
+        """
+        Returns the resources used since the earlier usage of the same process. The max resident set
+        size cannot be split, so it stays the peak of the process so far.
+        """
+        return ResourceUsage(userTimeInSeconds = self._userTimeInSeconds - earlier.userTimeInSeconds,
+                             systemTimeInSeconds =
+                                 self._systemTimeInSeconds - earlier.systemTimeInSeconds,
+                             maxResidentSetInKbs = self._maxResidentSetInKbs,
+                             maxResidentSetIsExact = self._maxResidentSetIsExact,
+                             minorPageFaults = self._minorPageFaults - earlier.minorPageFaults,
+                             majorPageFaults = self._majorPageFaults - earlier.majorPageFaults,
+                             voluntaryContextSwitches =
+                                 self._voluntaryContextSwitches - earlier.voluntaryContextSwitches,
+                             involuntaryContextSwitches =
+                                 self._involuntaryContextSwitches - earlier.involuntaryContextSwitches)
+    # Pylint overrides for the upcoming accessors.
+    #     pylint: disable = missing-function-docstring, multiple-statements
+    @property
+    def userTimeInSeconds(self) -> float: return self._userTimeInSeconds
+    @property
+    def systemTimeInSeconds(self) -> float: return self._systemTimeInSeconds
+    @property
+    def cpuTimeInSeconds(self) -> float: return self._userTimeInSeconds + self._systemTimeInSeconds
+    @property
+    def maxResidentSetInMbs(self) -> float: return self._maxResidentSetInKbs / 1024
+    @property
+    def maxResidentSetIsExact(self) -> bool: return self._maxResidentSetIsExact
+    @property
+    def minorPageFaults(self) -> int: return self._minorPageFaults
+    @property
+    def majorPageFaults(self) -> int: return self._majorPageFaults
+    @property
+    def voluntaryContextSwitches(self) -> int: return self._voluntaryContextSwitches
+    @property
+    def involuntaryContextSwitches(self) -> int: return self._involuntaryContextSwitches
 
 class ExecuteResult:
     """Represents the result of a program execution."""
     _status : ExecuteResultStatus
     _elapsedTimeInSeconds : float
+    _usage : Optional[ResourceUsage]
     _nonZeroExitCode : Optional[int]
     _output : Optional[str]
+    _gradeRatio : Optional[float]
+    _errors : Optional[str]
     #
     def __init__(self, *,
                  status : ExecuteResultStatus,
                  elapsedTimeInSeconds : float,
+                 usage : Optional[ResourceUsage],
                  nonZeroExitCode : Optional[int],
-                 output : Optional[str]):
+                 output : Optional[str],
+                 gradeRatio : Optional[float] = None,
+                 errors : Optional[str] = None):
+        """
+        Constructs the result. The grade ratio is given for a checker whose output does not contain
+        it (see CHECKER_SERVER_BINARY), in which case the output is the further output only. The
+        errors are what the program wrote to its standard error, if it is read apart from the output.
+        """
         self._status = status
         self._elapsedTimeInSeconds = elapsedTimeInSeconds
+        self._usage = usage
         self._nonZeroExitCode = nonZeroExitCode
         self._output = output
+        self._gradeRatio = gradeRatio
+        self._errors = errors
     # Pylint overrides for the upcoming accessors.
     #     pylint: disable = missing-function-docstring, multiple-statements
     @property
@@ -159,10 +566,19 @@ class ExecuteResult:
     @property
     def elapsedTimeInSeconds(self) -> float: return self._elapsedTimeInSeconds
     @property
+    def usage(self) -> Optional[ResourceUsage]: return self._usage
+    @property
+    def cpuTimeInSeconds(self) -> Optional[float]:
+        return None if (self._usage is None) else self._usage.cpuTimeInSeconds
+    @property
     def nonZeroExitCode(self) -> Optional[int]: return self._nonZeroExitCode
     @property
     def output(self) -> Optional[str]: return self._output
     @property
+    def gradeRatio(self) -> Optional[float]: return self._gradeRatio
+    @property
+    def errors(self) -> Optional[str]: return self._errors
+    @property
     def likelySignal(self) -> Optional[str]:
         if self._nonZeroExitCode is not None:
             # noinspection PyBroadException
@@ -178,10 +594,15 @@ class ExecuteResult:
 class ExecutableFromSources: # pylint: disable = too-few-public-methods
     '''
     Represents an executable program, referred with its sources. Compilation/preparation occurs
-    during construction.
+    during construction. If a cache directory is given, a compiled executable is reused from there
+    (see CHECKER_CACHE_DIRECTORY). If a shared cache directory is given, only the shared sources and
+    headers are reused from there (see COMPILATION_CACHE_DIRECTORY). The sources are given relative
+    to the given directory, where the program is prepared, and the messages are printed to report.
     '''
     _name : str
+    _directory : str
     _args : List[str]
+    _programFile : str
     _compilationSuccessful : bool
     #
     def __init__(self,
@@ -191,18 +612,26 @@ class ExecutableFromSources: # pylint: disable = too-few-public-methods
                  compiler : Literal["gcc", "g++", "python3"],
                  flags : List[str],
                  compilationTimeout : float,
-                 delayErrorToExecution : bool):
+                 delayErrorToExecution : bool,
+                 cacheDirectory : Optional[str] = None,
+                 sharedSources : Optional[List[str]] = None,
+                 sharedHeaders : Optional[List[str]] = None,
+                 sharedCacheDirectory : Optional[str] = None,
+                 directory : str = ".",
+                 report : TextIO = stdout):
         assert name.isalnum()
         self._name = name
+        self._directory = directory
         if compiler == "python3":
             assert len(sources) == 1
-            print(f"[INFO] Copying {name}...")
+            print(f"[INFO] Copying {name}...", file = report)
             try:
-                copyfile(sources[0], name)
-                self._args = ["/usr/bin/python3"] + flags + [name]
+                copyfile(inDirectory(directory, sources[0]), inDirectory(directory, name))
+                self._args = ["/usr/bin/python3"] + flags + [inDirectory(directory, name)]
+                self._programFile = inDirectory(directory, name)
                 self._compilationSuccessful = True
-                print("[SUCCESS] Copy finished.")
-                print()
+                print("[SUCCESS] Copy finished.", file = report)
+                print(file = report)
             except Exception as e: # pylint: disable = broad-exception-caught
                 self._args = []
                 self._compilationSuccessful = False
@@ -210,109 +639,357 @@ class ExecutableFromSources: # pylint: disable = too-few-public-methods
                     raise e
         else:
             assert compiler in ("gcc", "g++"), "Unexpected compiler."
-            print(f"[INFO] Compiling {name}...")
-            print("[INFO] Compiler flags:", " ".join(flags))
-            compileCommand = [compiler] + sources + ["-o", name] + flags
+            cachedFile : Optional[str] = None
+            if cacheDirectory is not None:
+                cachedFile = cachedExecutablePath(cacheDirectory = cacheDirectory,
+                                                  name = name,
+                                                  sources = sources,
+                                                  compiler = compiler,
+                                                  flags = flags,
+                                                  directory = directory)
+            if cachedFile is not None and exists(cachedFile):
+                print(f"[INFO] Using the cached {name}.", file = report)
+                print(file = report)
+                self._args = [cachedFile]
+                self._programFile = cachedFile
+                self._compilationSuccessful = True
+                return
+            # Compile into a temporary file in the cache, which is then renamed atomically.
+            outputFile = name if cachedFile is None else f"{cachedFile}.{getpid()}.tmp"
+            print(f"[INFO] Compiling {name}...", file = report)
+            print("[INFO] Compiler flags:", " ".join(flags), file = report)
+            # Use the cached objects of the shared sources in place of them, and the precompiled
+            # shared headers, which the compiler picks up from the ".gch" files next to them.
+            objects : Dict[str, str] = {}
+            precompiledHeaders : List[str] = []
+            if sharedCacheDirectory is not None:
+                for source in sharedSources or []:
+                    if source in sources:
+                        cachedObject = cachedSharedPart(cacheDirectory = sharedCacheDirectory,
+                                                        source = source,
+                                                        compiler = compiler,
+                                                        flags = flags,
+                                                        isHeader = False,
+                                                        compilationTimeout = compilationTimeout,
+                                                        directory = directory)
+                        if cachedObject is not None:
+                            objects[source] = cachedObject
+                for header in sharedHeaders or []:
+                    cachedHeader = cachedSharedPart(cacheDirectory = sharedCacheDirectory,
+                                                    source = header,
+                                                    compiler = compiler,
+                                                    flags = flags,
+                                                    isHeader = True,
+                                                    compilationTimeout = compilationTimeout,
+                                                    directory = directory)
+                    if cachedHeader is not None:
+                        precompiledHeader = inDirectory(directory, f"{header}.gch")
+                        if lexists(precompiledHeader):
+                            remove(precompiledHeader)
+                        symlink(cachedHeader, precompiledHeader)
+                        precompiledHeaders.append(precompiledHeader)
+                reused = list(objects) + \
+                         [header for header in sharedHeaders or []
+                          if inDirectory(directory, f"{header}.gch") in precompiledHeaders]
+                if len(reused) > 0:
+                    print("[INFO] Reusing the compiled", ", ".join(reused), file = report)
+            compileCommand = [compiler] + [objects.get(source, source) for source in sources] + \
+                             ["-o", outputFile] + flags
             try:
+                # The compiler runs in the directory, so that its messages refer to the sources as
+                # they are given.
                 compileOutput : str = check_output(compileCommand,
                                                    stderr=STDOUT,
-                                                   timeout=compilationTimeout).decode("utf-8")
-                self._args = [f"./{name}"]
+                                                   timeout=compilationTimeout,
+                                                   cwd=directory).decode("utf-8")
+                if cachedFile is not None:
+                    replace(outputFile, cachedFile)
+                    self._args = [cachedFile]
+                else:
+                    self._args = [join(directory, name)]
+                self._programFile = self._args[0]
                 self._compilationSuccessful = True
-                print("[SUCCESS] Compilation finished.")
+                print("[SUCCESS] Compilation finished.", file = report)
                 compileOutput = compileOutput.strip()
                 if compileOutput != "":
-                    print("[INFO] Compiler Output:")
-                    printFormatted(compileOutput.strip())
-                print()
+                    print("[INFO] Compiler Output:", file = report)
+                    printFormatted(compileOutput.strip(), file = report)
+                print(file = report)
             except CalledProcessError as cpe:
                 self._args = []
                 self._compilationSuccessful = False
-                print("[ERROR] Compilation failed.")
-                print("[INFO] Compiler Output:")
-                printFormatted(cpe.output.decode("utf-8"))
-                print()
+                print("[ERROR] Compilation failed.", file = report)
+                print("[INFO] Compiler Output:", file = report)
+                printFormatted(cpe.output.decode("utf-8"), file = report)
+                print(file = report)
                 if not delayErrorToExecution:
                     raise cpe
             except TimeoutExpired as te:
                 self._args = []
                 self._compilationSuccessful = False
-                print("[ERROR] Compilation timed out.")
-                print()
+                print("[ERROR] Compilation timed out.", file = report)
+                print(file = report)
                 if not delayErrorToExecution:
                     raise te
+            finally:
+                if outputFile != name and exists(inDirectory(directory, outputFile)):
+                    remove(inDirectory(directory, outputFile))
+                for precompiledHeader in precompiledHeaders:
+                    remove(precompiledHeader)
+    # Pylint overrides for the upcoming accessors.
+    #     pylint: disable = missing-function-docstring, multiple-statements
+    @property
+    def directory(self) -> str: return self._directory
+    @property
+    def args(self) -> List[str]: return self._args
+    @property
+    def compilationSuccessful(self) -> bool: return self._compilationSuccessful
     #
-    def _execute(self,
-                 *,
-                 args : List[str],
-                 stdinFile : Optional[str],
-                 stdoutFile : Optional[str],
-                 timeLimitInSeconds : float,
-                 memoryLimitInMbs : Optional[int],
-                 stackLimitInMbs : Optional[int]) -> ExecuteResult:
+    def programDigest(self) -> str:
+        """
+        Returns the SHA-256 of the compiled program (i.e., the executable or the copied script) and
+        the arguments that run it. Raises OSError if it cannot be read.
+        """
+        assert self._compilationSuccessful
+        digest = sha256()
+        for arg in self._args:
+            digest.update(b"arg\0" + arg.encode("utf-8") + b"\0")
+        with open(self._programFile, "rb") as stream:
+            digest.update(stream.read())
+        return digest.hexdigest()
+    #
+    def execute(self,
+                *,
+                args : List[str],
+                stdinFile : Optional[str],
+                stdoutFile : Optional[str],
+                timeLimitInSeconds : float,
+                cpuTimeLimitInSeconds : Optional[float],
+                memoryLimitInMbs : Optional[int],
+                stackLimitInMbs : Optional[int],
+                outputLimitInMbs : Optional[int] = None) -> ExecuteResult:
+        """
+        Executes the program. The run is stopped after timeLimitInSeconds of real time. If
+        cpuTimeLimitInSeconds is given, the run also exceeds the time limit if it uses more CPU time.
+        If stdoutFile is given, the output is written directly into it, without passing through this
+        process, and outputLimitInMbs limits its size. Otherwise, the output and the standard error are
+        returned apart.
+        """
         # Check if the executable is compiled.
         if not self._compilationSuccessful:
             return ExecuteResult(status = ExecuteResultStatus.CompilationFailed,
                                  elapsedTimeInSeconds = 0.0,
+                                 usage = None,
                                  nonZeroExitCode = None,
                                  output = None)
-        # Set resource limits.
-        if memoryLimitInMbs is not None:
-            setrlimit(RLIMIT_AS, (memoryLimitInMbs * 1024 * 1024, -1))
-        if stackLimitInMbs is not None:
-            setrlimit(RLIMIT_STACK, (stackLimitInMbs * 1024 * 1024, -1))
-        # Execute.
+        return self.start(args = args,
+                          stdinFile = stdinFile,
+                          stdoutFile = stdoutFile,
+                          timeLimitInSeconds = timeLimitInSeconds,
+                          cpuTimeLimitInSeconds = cpuTimeLimitInSeconds,
+                          memoryLimitInMbs = memoryLimitInMbs,
+                          stackLimitInMbs = stackLimitInMbs,
+                          outputLimitInMbs = outputLimitInMbs).wait()
+    #
+    def start(self,
+              *,
+              args : List[str],
+              stdinFile : Optional[str],
+              stdoutFile : Optional[str],
+              timeLimitInSeconds : float,
+              cpuTimeLimitInSeconds : Optional[float],
+              memoryLimitInMbs : Optional[int],
+              stackLimitInMbs : Optional[int],
+              outputLimitInMbs : Optional[int] = None) -> "Execution":
+        """
+        Starts executing the program, which must be compiled, with the parameters of execute(). The
+        result is obtained by waiting for the returned execution.
+        """
+        assert self._compilationSuccessful
         startTime = time()
-        #
+        # Without an output file, the standard error goes to a file of its own, so that what the
+        # program writes there (e.g., the counters of a checker) is told apart from its output.
+        errors = TemporaryFile() if stdoutFile is None else None
         try:
-            if stdinFile is not None:
-                with open(stdinFile, "rb") as inputStream:
-                    output = check_output(self._args + args,
-                                          stdin = inputStream,
-                                          stderr = STDOUT,
-                                          timeout = timeLimitInSeconds)
-            else:
-                output = check_output(self._args + args,
-                                      stderr = STDOUT,
-                                      timeout = timeLimitInSeconds)
-        except TimeoutExpired:
+            with open(stdinFile, "rb") if stdinFile is not None else nullcontext() as inputStream, \
+                 open(stdoutFile, "wb") if stdoutFile is not None else nullcontext() as outputStream:
+                process = Popen(limitedCommand(self._args + args,
+                                               cpuTimeLimitInSeconds = cpuTimeLimitInSeconds,
+                                               memoryLimitInMbs = memoryLimitInMbs,
+                                               stackLimitInMbs = stackLimitInMbs,
+                                               outputLimitInMbs = None if stdoutFile is None
+                                                                  else outputLimitInMbs),
+                                stdin = inputStream,
+                                stdout = PIPE if stdoutFile is None else outputStream,
+                                stderr = STDOUT if errors is None else errors)
+        except:
+            print(f"Unexpected error while executing {self._name}.")
+            if errors is not None:
+                errors.close()
+            raise
+        return Execution(process = process,
+                         startTime = startTime,
+                         deadline = startTime + timeLimitInSeconds,
+                         cpuTimeLimitInSeconds = cpuTimeLimitInSeconds,
+                         stdoutFile = stdoutFile,
+                         outputLimitInMbs = outputLimitInMbs,
+                         errors = errors)
+
+class Execution: # pylint: disable = too-few-public-methods
+    '''Represents a running execution of an ExecutableFromSources (see ExecutableFromSources.start()).'''
+    _process : Popen
+    _startTime : float
+    _deadline : float
+    _cpuTimeLimitInSeconds : Optional[float]
+    _stdoutFile : Optional[str]
+    _outputLimitInMbs : Optional[int]
+    _errors : Optional[BinaryIO]
+    #
+    def __init__(self,
+                 *,
+                 process : Popen,
+                 startTime : float,
+                 deadline : float,
+                 cpuTimeLimitInSeconds : Optional[float],
+                 stdoutFile : Optional[str],
+                 outputLimitInMbs : Optional[int],
+                 errors : Optional[BinaryIO] = None):
+        self._process = process
+        self._startTime = startTime
+        self._deadline = deadline
+        self._cpuTimeLimitInSeconds = cpuTimeLimitInSeconds
+        self._stdoutFile = stdoutFile
+        self._outputLimitInMbs = outputLimitInMbs
+        self._errors = errors
+    #
+    def wait(self, *, stop : Optional[Event] = None) -> ExecuteResult:
+        """
+        Waits for the execution to finish and returns its result. If the given event is set before
+        that, the execution is killed, and its status is Stopped.
+        """
+        process = self._process
+        output = bytearray()
+        timedOut = False
+        if process.stdout is not None:
+            with process.stdout:
+                while True:
+                    remainingTime = self._deadline - time()
+                    if remainingTime <= 0 or \
+                       not select([process.stdout], [], [], remainingTime)[0]:
+                        timedOut = True
+                        break
+                    chunk = read(process.stdout.fileno(), 65536)
+                    if chunk == b"":
+                        break
+                    output += chunk
+        # Reap the program with wait4(), which gives the CPU time of this very run. The CPU time of
+        # all children (see getrusage()) would also count the runs on the other workers.
+        status, rusage, killed = waitWithDeadline(process, deadline = self._deadline, stop = stop)
+        elapsedTime = time() - self._startTime
+        errors : Optional[bytes] = None
+        if self._errors is not None:
+            with self._errors:
+                self._errors.seek(0)
+                errors = self._errors.read()
+        usage = ResourceUsage.fromRusage(rusage,
+                                         inheritedMaxResidentSetInKbs =
+                                             getrusage(RUSAGE_SELF).ru_maxrss)
+        cpuTime = usage.cpuTimeInSeconds
+        exitCode = process.returncode = waitstatus_to_exitcode(status)
+        if killed and stop is not None and stop.is_set():
+            return ExecuteResult(status = ExecuteResultStatus.Stopped,
+                                 elapsedTimeInSeconds = elapsedTime,
+                                 usage = usage,
+                                 nonZeroExitCode = None,
+                                 output = None)
+        if timedOut or killed or \
+           (self._cpuTimeLimitInSeconds is not None and cpuTime > self._cpuTimeLimitInSeconds):
             return ExecuteResult(status = ExecuteResultStatus.TimeLimitExceeded,
-                                 elapsedTimeInSeconds = time() - startTime,
+                                 elapsedTimeInSeconds = elapsedTime,
+                                 usage = usage,
                                  nonZeroExitCode = None,
                                  output = None)
-        except CalledProcessError as cpe:
+        # The kernel stops the program with SIGXFSZ when it writes beyond the limit. An output of
+        # exactly the limit is accepted. A program that ignores the signal has its writes fail
+        # instead, so its output is checked as cut at the limit.
+        if self._stdoutFile is not None and self._outputLimitInMbs is not None and \
+           exitCode == -SIGXFSZ:
+            return ExecuteResult(status = ExecuteResultStatus.OutputLimitExceeded,
+                                 elapsedTimeInSeconds = elapsedTime,
+                                 usage = usage,
+                                 nonZeroExitCode = None,
+                                 output = None)
+        if exitCode != 0:
             return ExecuteResult(status = ExecuteResultStatus.NonZeroExitCode,
-                                 elapsedTimeInSeconds = time() - startTime,
-                                 nonZeroExitCode = cpe.returncode,
+                                 elapsedTimeInSeconds = elapsedTime,
+                                 usage = usage,
+                                 nonZeroExitCode = exitCode,
                                  output = None)
-        except:
-            print(f"Unexpected error while executing {self._name}.")
-            raise
-        #
-        elapsedTime = time() - startTime
-        if stdoutFile is not None:
-            with open(stdoutFile, "wb") as outputStream:
-                outputStream.write(output)
         return ExecuteResult(status = ExecuteResultStatus.Success,
                              elapsedTimeInSeconds = elapsedTime,
+                             usage = usage,
                              nonZeroExitCode = None,
-                             output = None if (stdoutFile is not None) else output.decode("utf-8"))
+                             output = None if (self._stdoutFile is not None)
+                                      else output.decode("utf-8"),
+                             errors = None if (errors is None) else errors.decode("utf-8"))
+
+# The header of a record of the "--binary-server" mode (see RecordHeader in OutputBuffer.ipp), i.e.,
+# the grade ratio and the length of the further output.
+RECORD_HEADER_FORMAT = "=dQ"
+RECORD_HEADER_SIZE = calcsize(RECORD_HEADER_FORMAT)
+
+class CheckerServer:
+    '''
+    Represents a checker that runs as a server (see CHECKER_SERVER), providing the same execute()
+    interface as ExecutableFromSources. The server is started upon the first execution, and restarted
+    if it does not survive an execution (e.g., due to a timeout).
+    '''
+    _executable : ExecutableFromSources
+    _process : Optional[Popen]
+    _errors : Optional[BinaryIO]
+    _errorsRead : int
+    #
+    def __init__(self, *, executable : ExecutableFromSources):
+        self._executable = executable
+        self._process = None
+        self._errors = None
+        self._errorsRead = 0
+    #
+    def close(self):
+        """Stops the server, if running."""
+        if self._process is not None:
+            self._process.kill()
+            self._process.wait()
+            self._process = None
+        if self._errors is not None:
+            self._errors.close()
+            self._errors = None
     #
-    def _executeSlave(self,
-                      *,
-                      args: List[str],
-                      stdinFile: Optional[str],
-                      stdoutFile: Optional[str],
-                      timeLimitInSeconds: float,
-                      memoryLimitInMbs: Optional[int],
-                      stackLimitInMbs: Optional[int],
-                      queue: "Queue[ExecuteResult]") -> None:  # TODO: Fix type hint in the future.
-        queue.put(self._execute(args = args,
-                                stdinFile = stdinFile,
-                                stdoutFile = stdoutFile,
-                                timeLimitInSeconds = timeLimitInSeconds,
-                                memoryLimitInMbs = memoryLimitInMbs,
-                                stackLimitInMbs = stackLimitInMbs))
+    def _readErrors(self) -> bytes:
+        """Returns what the server wrote to its standard error since the last call."""
+        assert self._errors is not None
+        fd = self._errors.fileno()
+        errors = pread(fd, fstat(fd).st_size - self._errorsRead, self._errorsRead)
+        self._errorsRead += len(errors)
+        return errors
+    #
+    def _read(self, *, count : Optional[int], deadline : float) -> Optional[bytes]:
+        """
+        Reads from the server until the given number of bytes are read or, if that is None, until a
+        '\\0' is read. Returns None if the deadline passes first, and fewer bytes if the server exits.
+        """
+        assert self._process is not None and self._process.stdout is not None
+        data = bytearray()
+        while (not data.endswith(b"\0")) if count is None else (len(data) < count):
+            remainingTime = deadline - time()
+            if remainingTime <= 0 or not select([self._process.stdout], [], [], remainingTime)[0]:
+                return None
+            chunk = read(self._process.stdout.fileno(),
+                         65536 if count is None else count - len(data))
+            if chunk == b"":
+                break
+            data += chunk
+        return bytes(data)
     #
     def execute(self,
                 *,
@@ -320,34 +997,109 @@ class ExecutableFromSources: # pylint: disable = too-few-public-methods
                 stdinFile : Optional[str],
                 stdoutFile : Optional[str],
                 timeLimitInSeconds : float,
+                cpuTimeLimitInSeconds : Optional[float],
                 memoryLimitInMbs : Optional[int],
-                stackLimitInMbs : Optional[int]) -> ExecuteResult:
-        """Executes the program."""
-        # If you wanted to execute without the slave process, it would look like this:
-        #     return self._execute(args = args,
-        #                          stdinFile = stdinFile,
-        #                          stdoutFile = stdoutFile,
-        #                          timeLimitInSeconds = timeLimitInSeconds,
-        #                          memoryLimitInMbs = memoryLimitInMbs,
-        #                          stackLimitInMbs = stackLimitInMbs)
-        # This would put the memory/stack limits on this process, though.
-        q : "Queue[ExecuteResult]" = Queue() # TODO: Fix type hint in the future.
-        p = Process(target = self._executeSlave,
-                    args=(),
-                    kwargs={"args": args,
-                            "stdinFile": stdinFile,
-                            "stdoutFile": stdoutFile,
-                            "timeLimitInSeconds": timeLimitInSeconds,
-                            "memoryLimitInMbs": memoryLimitInMbs,
-                            "stackLimitInMbs": stackLimitInMbs,
-                            "queue": q})
-        p.start()
-        p.join()
-        # noinspection PyBroadException
+                stackLimitInMbs : Optional[int],
+                outputLimitInMbs : Optional[int] = None) -> ExecuteResult:
+        """Executes the checker on the server."""
+        assert stdinFile is None and stdoutFile is None, "Redirection is not supported."
+        assert cpuTimeLimitInSeconds is None, "CPU time limit is not supported."
+        assert memoryLimitInMbs is None and stackLimitInMbs is None and outputLimitInMbs is None, \
+               "Limits are not supported."
+        assert all(("\t" not in arg) and ("\n" not in arg) for arg in args), \
+               "Arguments cannot contain tabs or newlines."
+        # Check if the executable is compiled.
+        if not self._executable.compilationSuccessful:
+            return ExecuteResult(status = ExecuteResultStatus.CompilationFailed,
+                                 elapsedTimeInSeconds = 0.0,
+                                 usage = None,
+                                 nonZeroExitCode = None,
+                                 output = None)
+        # Execute.
+        startTime = time()
+        if self._process is None:
+            # The standard error goes to a file, which the server appends to, so that what it
+            # writes there (e.g., its counters) is read after each record without blocking it.
+            self._errors = TemporaryFile(mode = "ab+")
+            self._errorsRead = 0
+            self._process = Popen(self._executable.args +
+                                  ["--binary-server" if CHECKER_SERVER_BINARY else "--server"],
+                                  stdin = PIPE,
+                                  stdout = PIPE,
+                                  stderr = self._errors)
+        assert self._process.stdin is not None and self._process.stdout is not None
+        # The server keeps running, so its resource usage for this execution is a difference.
+        startUsage = ResourceUsage.ofRunningProcess(self._process.pid)
+        deadline = startTime + timeLimitInSeconds
+        record : Optional[bytes] = b""
+        gradeRatio : Optional[float] = None
+        isComplete = False
         try:
-            return q.get(block = False)
-        except Exception as e:
-            raise RuntimeError("The slave process did not communicate as expected.") from e
+            self._process.stdin.write(("\t".join(args) + "\n").encode("utf-8"))
+            self._process.stdin.flush()
+            if CHECKER_SERVER_BINARY:
+                # The header gives the number of bytes that follow it.
+                record = self._read(count = RECORD_HEADER_SIZE, deadline = deadline)
+                if record is not None and len(record) == RECORD_HEADER_SIZE:
+                    gradeRatio, length = unpack(RECORD_HEADER_FORMAT, record)
+                    record = self._read(count = length, deadline = deadline)
+                    isComplete = record is not None and len(record) == length
+            else:
+                record = self._read(count = None, deadline = deadline)
+                isComplete = record is not None and record.endswith(b"\0")
+        except BrokenPipeError:
+            pass
+        #
+        if record is None:
+            self.close()
+            return ExecuteResult(status = ExecuteResultStatus.TimeLimitExceeded,
+                                 elapsedTimeInSeconds = time() - startTime,
+                                 usage = None,
+                                 nonZeroExitCode = None,
+                                 output = None)
+        elapsedTime = time() - startTime
+        if not isComplete:
+            exitCode = self._process.wait()
+            self._process = None
+            return ExecuteResult(status = ExecuteResultStatus.NonZeroExitCode,
+                                 elapsedTimeInSeconds = elapsedTime,
+                                 usage = None,
+                                 nonZeroExitCode = exitCode,
+                                 output = None)
+        endUsage = ResourceUsage.ofRunningProcess(self._process.pid)
+        usage = None if (startUsage is None or endUsage is None) else endUsage.since(startUsage)
+        if (gradeRatio is not None and gradeRatio < 0) or record == b"\0":
+            self._readErrors()
+            return ExecuteResult(status = ExecuteResultStatus.NonZeroExitCode,
+                                 elapsedTimeInSeconds = elapsedTime,
+                                 usage = usage,
+                                 nonZeroExitCode = 1,
+                                 output = None)
+        # The standard error is returned apart, as it is for a checker run on its own.
+        message = record if CHECKER_SERVER_BINARY else record[:-1]
+        return ExecuteResult(status = ExecuteResultStatus.Success,
+                             elapsedTimeInSeconds = elapsedTime,
+                             usage = usage,
+                             nonZeroExitCode = None,
+                             output = message.decode("utf-8"),
+                             gradeRatio = gradeRatio,
+                             errors = self._readErrors().decode("utf-8"))
+
+def readPreview(file : str, *, limit : Optional[int]) -> Tuple[str, int]:
+    """
+    Returns the text of the first limit bytes of the given file (or of all of it, if limit is None),
+    without its final newline, and the number of bytes omitted. Only these bytes are read, and a
+    character that is cut at the limit is omitted as well.
+    """
+    with open(file, "rb") as stream:
+        size = fstat(stream.fileno()).st_size
+        data = stream.read() if limit is None else stream.read(limit)
+    isCut = len(data) < size
+    # The decoder keeps back the bytes of a cut character if the data is not final.
+    text = getincrementaldecoder("utf-8")(errors = "replace").decode(data, final = not isCut)
+    if text.endswith("\n"):
+        text = text[0:-1]
+    return text, size - len(data) if isCut else 0
 
 class TestCase:
     '''Represents a test case.'''
@@ -356,13 +1108,40 @@ class TestCase:
     _outputFile : str
     _grade : float
     _hidden : bool
+    _timeLimitInSeconds : float
+    _wallTimeLimitInSeconds : float
+    _memoryLimitInMbs : int
+    _checker : str
+    _inputSize : int
+    _preview : Optional[Tuple[Tuple[str, int], Tuple[str, int]]]
     def __init__(self, *, label : str, inputFile : str, outputFile : str, grade : float,
-                 hidden : bool):
+                 hidden : bool, timeLimitInSeconds : float = TIME_LIMIT_IN_SECONDS,
+                 wallTimeLimitInSeconds : float = WALL_TIME_LIMIT_IN_SECONDS,
+                 memoryLimitInMbs : int = MEMORY_LIMIT_IN_MBS, checker : str = "default",
+                 inputSize : int = 0):
         self._label = label
         self._inputFile = inputFile
         self._outputFile = outputFile
         self._grade = grade
         self._hidden = hidden
+        self._timeLimitInSeconds = timeLimitInSeconds
+        self._wallTimeLimitInSeconds = wallTimeLimitInSeconds
+        self._memoryLimitInMbs = memoryLimitInMbs
+        self._checker = checker
+        self._inputSize = inputSize
+        self._preview = None
+    #
+    def preview(self) -> Tuple[Tuple[str, int], Tuple[str, int]]:
+        """
+        Returns the input and the expected output as they are shown before running the test case (see
+        SHOW_INPUT_OUTPUT), each with the number of bytes omitted from it (see readPreview). The files
+        are read once, and the texts are shared by all submissions graded in this run (see
+        gradeBatch).
+        """
+        if self._preview is None:
+            self._preview = (readPreview(self._inputFile, limit = SHOWN_INPUT_OUTPUT_BYTES),
+                             readPreview(self._outputFile, limit = SHOWN_INPUT_OUTPUT_BYTES))
+        return self._preview
     # Pylint overrides for the upcoming accessors.
     #     pylint: disable = missing-function-docstring, multiple-statements
     @property
@@ -375,94 +1154,401 @@ class TestCase:
     def grade(self) -> float: return self._grade
     @property
     def hidden(self) -> bool: return self._hidden
+    @property
+    def timeLimitInSeconds(self) -> float: return self._timeLimitInSeconds
+    @property
+    def wallTimeLimitInSeconds(self) -> float: return self._wallTimeLimitInSeconds
+    @property
+    def memoryLimitInMbs(self) -> int: return self._memoryLimitInMbs
+    @property
+    def checker(self) -> str: return self._checker
+    @property
+    def inputSize(self) -> int: return self._inputSize
 
-def getTestCases(*, totalGrade : float) -> List[TestCase]:
-    '''Obtains a list of available test cases.'''
+class ResultCache:
+    '''
+    Represents the cache of the results of the test cases across grading runs (see
+    RESULT_CACHE_DIRECTORY). A result is the grade and the report of a test case.
+    '''
+    _directory : str
+    _runDigest : str
+    #
+    def __init__(self, *, directory : str, runDigest : str):
+        self._directory = directory
+        self._runDigest = runDigest
+    #
+    @staticmethod
+    def create(*,
+               directory : str,
+               testSubject : ExecutableFromSources,
+               checkers : Dict[str, ExecutableFromSources]) -> Optional["ResultCache"]:
+        """
+        Returns the cache for the given test subject and checkers (see NAMED_CHECKERS), or None if the
+        cache is unusable, e.g., as the test subject is not compiled.
+        """
+        if not testSubject.compilationSuccessful or \
+           not all(checker.compilationSuccessful for checker in checkers.values()):
+            return None
+        try:
+            digest = sha256()
+            digest.update(sourcesDigest(sources = SOURCE_FILES,
+                                        compiler = COMPILER,
+                                        flags = COMPILER_FLAGS,
+                                        directory = testSubject.directory).encode("utf-8"))
+            for name in sorted(checkers):
+                digest.update(checkers[name].programDigest().encode("utf-8"))
+            # The settings with which the same test case may get a different result.
+            digest.update(repr((TIME_LIMIT_IN_SECONDS, WALL_TIME_LIMIT_IN_SECONDS, MEMORY_LIMIT_IN_MBS,
+                                STACK_LIMIT_IN_MBS, OUTPUT_LIMIT_IN_MBS, STREAM_TO_CHECKER,
+                                CHECKER_TIMEOUT, SHOW_INPUT_OUTPUT,
+                                SHOWN_INPUT_OUTPUT_BYTES)).encode("utf-8"))
+            makedirs(directory, exist_ok = True)
+            return ResultCache(directory = directory, runDigest = digest.hexdigest())
+        except (OSError, CalledProcessError):
+            return None
+    #
+    def _path(self, testCase : TestCase) -> str:
+        digest = sha256(self._runDigest.encode("utf-8"))
+        digest.update(repr((testCase.label, testCase.grade, testCase.hidden,
+                            testCase.timeLimitInSeconds, testCase.wallTimeLimitInSeconds,
+                            testCase.memoryLimitInMbs, testCase.checker)).encode("utf-8"))
+        # The checker may also read the files named after the output file, e.g., the tolerance file of
+        # diff_checker_real.cpp.
+        sideFiles = sorted(glob(escapeGlob(testCase.outputFile) + ".*"))
+        digest.update(repr(sideFiles).encode("utf-8"))
+        for file in [testCase.inputFile, testCase.outputFile] + sideFiles:
+            with open(file, "rb") as stream:
+                digest.update(sha256(stream.read()).digest())
+        return join(self._directory, f"{digest.hexdigest()}.json")
+    #
+    def get(self, testCase : TestCase) -> Optional[Tuple[float, str]]:
+        """Returns the cached result of the given test case, or None if there is none."""
+        try:
+            with open(self._path(testCase), "r", encoding = "utf-8") as stream:
+                result = load(stream)
+            return float(result["grade"]), str(result["report"])
+        except (OSError, ValueError, KeyError, TypeError):
+            return None
+    #
+    def put(self, testCase : TestCase, grade : float, report : str):
+        """Caches the result of the given test case, if possible."""
+        try:
+            path = self._path(testCase)
+            temporaryFile = f"{path}.{getpid()}.{get_ident()}.tmp"
+            with open(temporaryFile, "w", encoding = "utf-8") as stream:
+                dump({"grade": grade, "report": report}, stream)
+            replace(temporaryFile, path)
+        except OSError:
+            pass
+
+def testCaseFiles(name : str) -> Tuple[str, str, str, bool]:
+    '''
+    Returns the label, the input file, the output file and whether the test case is hidden for the
+    test case with the given name, i.e., the name of its input file without INPUT_SUFFIX.
+    '''
+    inputFile = name + INPUT_SUFFIX
+    outputFile = name + OUTPUT_SUFFIX
+    if HIDDEN_SUFFIX is not None and name.endswith(HIDDEN_SUFFIX):
+        return name if HIDDEN_SUFFIX == "" else name[:-len(HIDDEN_SUFFIX)], inputFile, outputFile, True
+    return name, inputFile, outputFile, False
+
+def parsesAs(text : str, kind : type) -> bool:
+    '''Returns whether the given text is a valid literal of the given type, e.g., int.'''
+    try:
+        kind(text)
+        return True
+    except ValueError:
+        return False
+
+def readTestCasesFile(file : str, *, totalGrade : float) -> List[TestCase]:
+    '''Reads the test cases listed in the given file (see TEST_CASES_FILE), if any.'''
+    entries : List[Tuple[str, Dict[str, str]]] = []
+    with open(file, "r", encoding = "utf-8") as stream:
+        for lineNumber, line in enumerate(stream, start = 1):
+            fields = line.split("#", maxsplit = 1)[0].split()
+            if len(fields) == 0:
+                continue
+            settings : Dict[str, str] = {}
+            for field in fields[1:]:
+                key, separator, value = field.partition("=")
+                assert separator == "=" and key in ("weight", "time", "memory", "checker") and \
+                       key not in settings, f"{file}:{lineNumber}: Unexpected \"{field}\"."
+                assert key == "checker" or parsesAs(value, int if key == "memory" else float), \
+                       f"{file}:{lineNumber}: Invalid value in \"{field}\"."
+                settings[key] = value
+            entries.append((fields[0], settings))
+    #
+    weights = [float(settings.get("weight", 1)) for _, settings in entries]
+    totalWeight = sum(weights)
+    assert all(weight >= 0 for weight in weights) and (len(entries) == 0 or totalWeight > 0), \
+           f"The weights in {file} are invalid."
     cases : List[TestCase] = []
+    for (name, settings), weight in zip(entries, weights):
+        label, inputFile, outputFile, hidden = testCaseFiles(name)
+        assert exists(inputFile), f"{inputFile} is missing."
+        assert exists(outputFile), f"{outputFile} is missing."
+        timeLimit = float(settings.get("time", TIME_LIMIT_IN_SECONDS))
+        assert timeLimit > 0, f"The time limit of {name} is invalid."
+        checker = settings.get("checker", "default")
+        assert checker == "default" or checker in NAMED_CHECKERS, f"{checker} is not a checker."
+        cases.append(TestCase(label = label,
+                              inputFile = inputFile,
+                              outputFile = outputFile,
+                              grade = totalGrade * weight / totalWeight,
+                              hidden = hidden,
+                              timeLimitInSeconds = timeLimit,
+                              wallTimeLimitInSeconds =
+                                  WALL_TIME_LIMIT_IN_SECONDS * timeLimit / TIME_LIMIT_IN_SECONDS,
+                              memoryLimitInMbs = int(settings.get("memory", MEMORY_LIMIT_IN_MBS)),
+                              checker = checker,
+                              inputSize = getsize(inputFile)))
+    return cases
+
+def getTestCases(*, totalGrade : float) -> List[TestCase]:
+    '''
+    Obtains a list of available test cases, from TEST_CASES_FILE if it lists any, and otherwise by
+    INPUT_SUFFIX.
+    '''
+    if TEST_CASES_FILE is not None and exists(TEST_CASES_FILE):
+        cases = readTestCasesFile(TEST_CASES_FILE, totalGrade = totalGrade)
+        if len(cases) > 0:
+            return cases
+    cases = []
     inputFiles = sorted(glob("*" + INPUT_SUFFIX))
     assert len(inputFiles) > 0, "There are no input files."
     gradePerInput : float = totalGrade / len(inputFiles)
     for inputFile in inputFiles:
-        inputFileWithoutInputSuffix = inputFile[:-len(INPUT_SUFFIX)]
-        outputFile = inputFileWithoutInputSuffix + OUTPUT_SUFFIX
+        label, inputFile, outputFile, hidden = testCaseFiles(inputFile[:-len(INPUT_SUFFIX)])
         assert exists(outputFile), f"{outputFile} is missing."
-        #
-        hidden : bool
-        label : str
-        if HIDDEN_SUFFIX is not None and inputFileWithoutInputSuffix.endswith(HIDDEN_SUFFIX):
-            hidden = True
-            label = inputFileWithoutInputSuffix if HIDDEN_SUFFIX == ""\
-                    else inputFileWithoutInputSuffix[:-len(HIDDEN_SUFFIX)]
-        else:
-            hidden = False
-            label = inputFileWithoutInputSuffix
-        #
         cases.append(TestCase(label = label,
                               inputFile = inputFile,
                               outputFile = outputFile,
                               grade = gradePerInput,
-                              hidden = hidden))
+                              hidden = hidden,
+                              inputSize = getsize(inputFile)))
     return cases
 
+def schedulingOrder(cases : List[TestCase]) -> List[TestCase]:
+    '''Returns the given test cases in the order to run them, i.e., the longest one first.'''
+    return sorted(cases, key = lambda case: (case.timeLimitInSeconds, case.inputSize), reverse = True)
+
+def printUsage(*,
+               result : ExecuteResult,
+               program : Optional[str],
+               memoryLimitInMbs : Optional[int],
+               report : TextIO):
+    """
+    Prints the [INFO] lines on the time and the resources used by an execution of the given program,
+    which is None for the test subject.
+    """
+    usage = result.usage
+    timeText = f"{result.elapsedTimeInSeconds:.2f} seconds"
+    if usage is not None:
+        timeText += (f" ({usage.cpuTimeInSeconds:.2f} seconds of CPU time: "
+                     f"{usage.userTimeInSeconds:.2f} user + {usage.systemTimeInSeconds:.2f} system)")
+    if program is None:
+        print(f"[INFO] Elapsed time was {timeText}.", file = report)
+    else:
+        print(f"[INFO] {program} ran for {timeText}.", file = report)
+    if usage is not None:
+        limit = "" if (memoryLimitInMbs is None) else f" (limit: {memoryLimitInMbs} MBs)"
+        print(f"[INFO] {'Peak memory' if program is None else f'{program} peak memory'} was "
+              f"{'' if usage.maxResidentSetIsExact else 'at most '}"
+              f"{usage.maxResidentSetInMbs:.1f} MBs{limit}, with "
+              f"{usage.minorPageFaults + usage.majorPageFaults} page faults "
+              f"({usage.majorPageFaults} major) and "
+              f"{usage.voluntaryContextSwitches + usage.involuntaryContextSwitches} context switches "
+              f"({usage.involuntaryContextSwitches} involuntary).", file = report)
+
+def isFullGrade(checkerResult : ExecuteResult) -> bool:
+    """Returns whether the checker succeeded and gave the full grade."""
+    if checkerResult.status == ExecuteResultStatus.Success and checkerResult.gradeRatio is not None:
+        return checkerResult.gradeRatio == 1.0
+    if checkerResult.status != ExecuteResultStatus.Success or checkerResult.output is None or \
+       "|" not in checkerResult.output:
+        return False
+    try:
+        return float(checkerResult.output.split("|", maxsplit = 1)[0]) == 1.0
+    except ValueError:
+        return False
+
+def writesCheckerStats(checker : str) -> bool:
+    """
+    Returns whether the checker with the given name (see NAMED_CHECKERS) is built to write its
+    counters (see CHECKER_STATS_FILE).
+    """
+    flags = CHECKER_COMPILER_FLAGS if checker == "default" else NAMED_CHECKERS[checker][1]
+    return CHECKER_COMPILER != "python3" and "-DCHECKER_STATS" in flags
+
+def splitCheckerStats(errors : str) -> Tuple[str, Optional[Dict[str, float]]]:
+    """
+    Removes the line of counters that a checker writes to its standard error (see CHECKER_STATS_FILE)
+    from what it wrote there. Returns the rest of it and the counters, or None if there are none. Only
+    the standard error is searched, as the output of the checker may echo the output of the test
+    subject, which could then forge the counters.
+    """
+    index = errors.rfind('{"checkerStats": ')
+    if index < 0:
+        return errors, None
+    end = errors.find("\n", index)
+    end = len(errors) if end < 0 else end + 1
+    try:
+        stats = loads(errors[index:end])["checkerStats"]
+    except (ValueError, KeyError):
+        return errors, None
+    return errors[:index] + errors[end:], stats
+
+def printCheckerStats(*, stats : Dict[str, float], report : TextIO):
+    """Prints the counters of a checker (see splitCheckerStats) to the given report."""
+    print(f"[INFO] Checker read {stats['bytesMapped']:.0f} mapped and {stats['bytesRead']:.0f} "
+          f"streamed bytes (peak buffer: {stats['peakBufferBytes']:.0f} bytes), and parsed "
+          f"{stats['validTokens']:.0f} valid, {stats['spaceTokens']:.0f} space and "
+          f"{stats['newlineTokens']:.0f} newline tokens.", file = report)
+    print(f"[INFO] Checker spent {stats['parseSeconds']:.6f} seconds parsing, "
+          f"{stats['compareSeconds']:.6f} comparing and {stats['outputSeconds']:.6f} formatting "
+          f"the output.", file = report)
+
+def executeStreaming(*,
+                     testCase : TestCase,
+                     testSubject : ExecutableFromSources,
+                     checker : Union[ExecutableFromSources, CheckerServer],
+                     outputFile : str) -> Tuple[ExecuteResult, ExecuteResult]:
+    '''
+    Executes the test subject, which must be compiled, on the given test case while the checker reads
+    its output through the FIFO outputFile (see STREAM_TO_CHECKER). The test subject is stopped if the
+    checker does not give the full grade. Returns the results of the test subject and the checker.
+    '''
+    # Holding a reader keeps the test subject from getting SIGPIPE before the checker opens the FIFO
+    # and after the checker closes it early. Nothing is read from it.
+    reader = openDescriptor(outputFile, O_RDONLY | O_NONBLOCK)
+    try:
+        execution = testSubject.start(args = [],
+                                      stdinFile = testCase.inputFile,
+                                      stdoutFile = outputFile,
+                                      timeLimitInSeconds = testCase.wallTimeLimitInSeconds,
+                                      cpuTimeLimitInSeconds = testCase.timeLimitInSeconds,
+                                      memoryLimitInMbs = testCase.memoryLimitInMbs,
+                                      stackLimitInMbs = STACK_LIMIT_IN_MBS)
+        stop = Event()
+        results : List[ExecuteResult] = []
+        waiter = Thread(target = lambda: results.append(execution.wait(stop = stop)))
+        waiter.start()
+        try:
+            checkerResult = checker.execute(args = [testCase.inputFile,
+                                                    outputFile,
+                                                    testCase.outputFile,
+                                                    "1" if testCase.hidden else "0"],
+                                            stdinFile = None,
+                                            stdoutFile = None,
+                                            timeLimitInSeconds = testCase.wallTimeLimitInSeconds +
+                                                                 CHECKER_TIMEOUT,
+                                            cpuTimeLimitInSeconds = None,
+                                            memoryLimitInMbs = None,
+                                            stackLimitInMbs = None)
+            if not isFullGrade(checkerResult):
+                stop.set()
+        except:
+            stop.set()
+            raise
+        finally:
+            waiter.join()
+    finally:
+        closeDescriptor(reader)
+    assert len(results) == 1, "The test subject could not be waited."
+    return results[0], checkerResult
+
 def evaluate(*,
              testCase : TestCase,
              testSubject : ExecutableFromSources,
-             checker : ExecutableFromSources) -> float:
-    '''Evaluates the given test subject on the given test case with the given checker.'''
-    print(f"[INPUT] {testCase.label} ({testCase.grade:.2f} pts)")
+             checker : Union[ExecutableFromSources, CheckerServer],
+             outputFile : str,
+             report : TextIO) -> Tuple[float, Optional[Dict[str, float]], bool]:
+    '''
+    Evaluates the given test subject on the given test case with the given checker. The output of the
+    test subject is written to outputFile, and the report for the test case is printed to report.
+    Returns the grade, the counters of the checker, if it wrote any (see CHECKER_STATS_FILE), and
+    whether the grade is reproducible, i.e., the test subject exited by itself within its limits and
+    the checker succeeded, rather than depending on, e.g., the load of the machine.
+    '''
+    print(f"[INPUT] {testCase.label} ({testCase.grade:.2f} pts)", file = report)
     if SHOW_INPUT_OUTPUT:
         if testCase.hidden:
-            print("[INFO] The input/output is intentionally hidden.")
+            print("[INFO] The input/output is intentionally hidden.", file = report)
         else:
-            print("Input:")
-            with open(testCase.inputFile, "r", encoding = "utf-8") as stream:
-                data = stream.read()
-                if data.endswith("\n"):
-                    data = data[0:-1]
-                printFormatted(data)
-            print("Expected output:")
-            with open(testCase.outputFile, "r", encoding = "utf-8") as stream:
-                data = stream.read()
-                if data.endswith("\n"):
-                    data = data[0:-1]
-                printFormatted(data)
-    result : ExecuteResult = testSubject.execute(args = [],
-                                                 stdinFile = testCase.inputFile,
-                                                 stdoutFile = OUTPUT_FILE,
-                                                 timeLimitInSeconds = TIME_LIMIT_IN_SECONDS,
-                                                 memoryLimitInMbs = MEMORY_LIMIT_IN_MBS,
-                                                 stackLimitInMbs = STACK_LIMIT_IN_MBS)
+            for title, (text, omittedBytes) in zip(("Input:", "Expected output:"),
+                                                   testCase.preview()):
+                print(title, file = report)
+                printFormatted(text, file = report)
+                if omittedBytes > 0:
+                    print(f"[INFO] The rest ({omittedBytes} bytes) is not shown.", file = report)
+    result : ExecuteResult
+    checkerResult : Optional[ExecuteResult] = None
+    stats : Optional[Dict[str, float]] = None
+    reproducible = False
+    if STREAM_TO_CHECKER and testSubject.compilationSuccessful:
+        result, checkerResult = executeStreaming(testCase = testCase,
+                                                 testSubject = testSubject,
+                                                 checker = checker,
+                                                 outputFile = outputFile)
+    else:
+        result = testSubject.execute(args = [],
+                                     stdinFile = testCase.inputFile,
+                                     stdoutFile = outputFile,
+                                     timeLimitInSeconds = testCase.wallTimeLimitInSeconds,
+                                     cpuTimeLimitInSeconds = testCase.timeLimitInSeconds,
+                                     memoryLimitInMbs = testCase.memoryLimitInMbs,
+                                     stackLimitInMbs = STACK_LIMIT_IN_MBS,
+                                     outputLimitInMbs = OUTPUT_LIMIT_IN_MBS)
     if result.status == ExecuteResultStatus.CompilationFailed:
-        print(f"[INCORRECT] Prior compilation failed.")
+        print(f"[INCORRECT] Prior compilation failed.", file = report)
         grade = 0.0
     elif result.status == ExecuteResultStatus.TimeLimitExceeded:
-        print(f"[INCORRECT] Time limit exceeded.")
-        print(f"[INFO] Elapsed time was {result.elapsedTimeInSeconds:.2f} seconds.")
+        print(f"[INCORRECT] Time limit exceeded.", file = report)
+        printUsage(result = result, program = None, memoryLimitInMbs = testCase.memoryLimitInMbs,
+                   report = report)
+        grade = 0.0
+    elif result.status == ExecuteResultStatus.OutputLimitExceeded:
+        print(f"[INCORRECT] Output limit ({OUTPUT_LIMIT_IN_MBS} MBs) exceeded.", file = report)
+        printUsage(result = result, program = None, memoryLimitInMbs = testCase.memoryLimitInMbs,
+                   report = report)
         grade = 0.0
     elif result.status == ExecuteResultStatus.NonZeroExitCode:
         signal = "" if (result.likelySignal is None) else f" ({result.likelySignal})"
-        print(f"[INCORRECT] Program returned {result.nonZeroExitCode}." + signal)
-        print(f"[INFO] Exceeding the memory/stack limits *MAY* be the issue.")
-        print(f"[INFO] Elapsed time was {result.elapsedTimeInSeconds:.2f} seconds.")
+        print(f"[INCORRECT] Program returned {result.nonZeroExitCode}." + signal, file = report)
+        reproducible = result.nonZeroExitCode is not None and result.nonZeroExitCode > 0
+        print(f"[INFO] Exceeding the memory/stack limits *MAY* be the issue.", file = report)
+        printUsage(result = result, program = None, memoryLimitInMbs = testCase.memoryLimitInMbs,
+                   report = report)
         grade = 0.0
     else:
-        assert result.status == ExecuteResultStatus.Success
-        checkerResult = checker.execute(args = [testCase.inputFile,
-                                                OUTPUT_FILE,
-                                                testCase.outputFile,
-                                                "1" if testCase.hidden else "0"],
-                                        stdinFile = None,
-                                        stdoutFile = None,
-                                        timeLimitInSeconds = CHECKER_TIMEOUT,
-                                        memoryLimitInMbs = None,
-                                        stackLimitInMbs = None)
+        # A streamed test subject is stopped once the checker finds its output wrong.
+        assert result.status in (ExecuteResultStatus.Success, ExecuteResultStatus.Stopped)
+        if checkerResult is None:
+            checkerResult = checker.execute(args = [testCase.inputFile,
+                                                    outputFile,
+                                                    testCase.outputFile,
+                                                    "1" if testCase.hidden else "0"],
+                                            stdinFile = None,
+                                            stdoutFile = None,
+                                            timeLimitInSeconds = CHECKER_TIMEOUT,
+                                            cpuTimeLimitInSeconds = None,
+                                            memoryLimitInMbs = None,
+                                            stackLimitInMbs = None)
         try:
             assert checkerResult.status == ExecuteResultStatus.Success, \
                    f"Checker execution failed. Status: {checkerResult.status}."
             assert checkerResult.output is not None, "Checker output not obtained."
-            assert "|" in checkerResult.output, "Checker output format is incorrect."
-            gradeRatioAsStr, output = checkerResult.output.split("|", maxsplit = 1)
-            gradeRatio = float(gradeRatioAsStr)
+            errors = checkerResult.errors or ""
+            if writesCheckerStats(testCase.checker):
+                errors, stats = splitCheckerStats(errors)
+            # The rest of the standard error follows the output, as if they were written together.
+            output = checkerResult.output + errors
+            if checkerResult.gradeRatio is not None:
+                gradeRatio = checkerResult.gradeRatio
+            else:
+                assert "|" in output, "Checker output format is incorrect."
+                gradeRatioAsStr, output = output.split("|", maxsplit = 1)
+                gradeRatio = float(gradeRatioAsStr)
             assert 0.0 <= gradeRatio <= 1.0, "Checker gave invalid grade."
             if gradeRatio == 1.0:
                 gradeText = "CORRECT"
@@ -471,55 +1557,256 @@ def evaluate(*,
             else:
                 gradeText = "PARTIAL"
             output = output.strip()
-            print(f"[{gradeText}] {output}")
+            print(f"[{gradeText}] {output}", file = report)
+            # A stopped test subject may have been stopped for being slow to produce the output.
+            reproducible = result.status == ExecuteResultStatus.Success
         # TODO: How do I (and should I) catch every exception in here?
         except Exception as e: # pylint: disable = broad-exception-caught
-            print(f"[FAILURE] Checker failed: {type(e).__name__}/{e}. No points.")
+            print(f"[FAILURE] Checker failed: {type(e).__name__}/{e}. No points.", file = report)
             gradeRatio = 0.0
         #
-        print(f"[INFO] Elapsed time was {result.elapsedTimeInSeconds:.2f} seconds.")
-        print(f"[INFO] Checker ran for {checkerResult.elapsedTimeInSeconds:.2f} seconds.")
+        printUsage(result = result, program = None, memoryLimitInMbs = testCase.memoryLimitInMbs,
+                   report = report)
+        printUsage(result = checkerResult, program = "Checker", memoryLimitInMbs = None, report = report)
+        if stats is not None:
+            printCheckerStats(stats = stats, report = report)
         grade = gradeRatio * testCase.grade
-    print(f"[POINTS] {grade:.2f} / {testCase.grade:.2f}")
-    print()
-    return grade
-
-def conveyGrade(*, grade : float, totalGrade : float):
-    '''Prints the grade and generates the necessary files for grade reporting.'''
-    print(f"[GRADE] Your grade is {grade:.2f} / {totalGrade:.2f}.")
-    print()
-    if exists("vpl_execution"):
-        remove("vpl_execution")
-    with open("vpl_execution", "w", encoding = "utf-8") as vplExecution:
+    print(f"[POINTS] {grade:.2f} / {testCase.grade:.2f}", file = report)
+    print(file = report)
+    return grade, stats, reproducible
+
+def conveyGrade(*, grade : float, totalGrade : float, directory : str = ".",
+                report : TextIO = stdout):
+    '''
+    Prints the grade to report and generates the necessary files for grade reporting in the given
+    directory.
+    '''
+    print(f"[GRADE] Your grade is {grade:.2f} / {totalGrade:.2f}.", file = report)
+    print(file = report)
+    executionFile = inDirectory(directory, "vpl_execution")
+    if exists(executionFile):
+        remove(executionFile)
+    with open(executionFile, "w", encoding = "utf-8") as vplExecution:
         vplExecution.write("#!/bin/bash\n")
         vplExecution.write("printf \"Grade :=>> " + str(grade) + "\"")
-    chmod("vpl_execution", S_IXUSR | S_IRUSR)
+    chmod(executionFile, S_IXUSR | S_IRUSR)
 
-def main():
-    '''Main function.'''
-    # Prepare checker.
-    checker = ExecutableFromSources(name = CHECKER_EXECUTABLE_NAME,
-                                    sources = CHECKER_SOURCE_FILES,
-                                    compiler = CHECKER_COMPILER,
-                                    flags = CHECKER_COMPILER_FLAGS,
-                                    compilationTimeout = CHECKER_COMPILER_TIMEOUT,
-                                    delayErrorToExecution = False)
+# A worker, i.e., the output file and the checkers by name (see NAMED_CHECKERS) with which a test case
+# is evaluated.
+Worker = Tuple[str, Dict[str, Union[ExecutableFromSources, CheckerServer]]]
+
+def prepareCheckers(cases : List[TestCase]) -> Dict[str, ExecutableFromSources]:
+    '''
+    Compiles the checkers that the given test cases use (see NAMED_CHECKERS), raising an exception if
+    one cannot be compiled. Returns them by name.
+    '''
+    checkers : Dict[str, ExecutableFromSources] = {}
+    for name in sorted(set(case.checker for case in cases)):
+        sources, flags = (CHECKER_SOURCE_FILES, CHECKER_COMPILER_FLAGS) if name == "default" \
+                         else NAMED_CHECKERS[name]
+        checkers[name] = ExecutableFromSources(name = CHECKER_EXECUTABLE_NAME if name == "default"
+                                                      else CHECKER_EXECUTABLE_NAME + name.capitalize(),
+                                               sources = sources,
+                                               compiler = CHECKER_COMPILER,
+                                               flags = flags,
+                                               compilationTimeout = CHECKER_COMPILER_TIMEOUT,
+                                               delayErrorToExecution = False,
+                                               cacheDirectory = CHECKER_CACHE_DIRECTORY)
+    return checkers
+
+def prepareTestSubject(*, directory : str, report : TextIO) -> ExecutableFromSources:
+    '''Compiles the test subject from the sources in the given directory.'''
+    return ExecutableFromSources(name = EXECUTABLE_NAME,
+                                 sources = SOURCE_FILES,
+                                 compiler = COMPILER,
+                                 flags = COMPILER_FLAGS,
+                                 compilationTimeout = COMPILER_TIMEOUT,
+                                 delayErrorToExecution = True,
+                                 sharedSources = SHARED_SOURCE_FILES,
+                                 sharedHeaders = SHARED_HEADER_FILES,
+                                 sharedCacheDirectory = COMPILATION_CACHE_DIRECTORY,
+                                 directory = directory,
+                                 report = report)
+
+def prepareWorkers(*,
+                   workerCount : int,
+                   checkers : Dict[str, ExecutableFromSources]) \
+        -> Tuple["SimpleQueue[Worker]", List[CheckerServer]]:
+    '''
+    Prepares the given number of workers, each with its own output file and checkers. Returns the
+    queue of the idle workers and the checker servers, which are to be closed after the evaluation.
+    '''
+    workers : "SimpleQueue[Worker]" = SimpleQueue()
+    servers : List[CheckerServer] = []
+    for index in range(workerCount):
+        workerCheckers : Dict[str, Union[ExecutableFromSources, CheckerServer]] = dict(checkers)
+        if CHECKER_SERVER:
+            # A server is started only once it is used.
+            for name, checker in checkers.items():
+                servers.append(CheckerServer(executable = checker))
+                workerCheckers[name] = servers[-1]
+        outputFile = OUTPUT_FILE if workerCount == 1 else f"{OUTPUT_FILE}{index}"
+        # A FIFO left from streaming would block the opening of the output file otherwise.
+        if lexists(outputFile):
+            remove(outputFile)
+        if STREAM_TO_CHECKER:
+            mkfifo(outputFile, 0o600)
+        workers.put((outputFile, workerCheckers))
+    return workers, servers
+
+def evaluateOnWorker(*,
+                     case : TestCase,
+                     testSubject : ExecutableFromSources,
+                     resultCache : Optional[ResultCache],
+                     workers : "SimpleQueue[Worker]") -> Tuple[float, str, Optional[Dict[str, float]]]:
+    '''
+    Evaluates the given test subject on the given test case with an idle worker, unless its result is
+    cached. Returns the grade, the report and the counters of the checker for the test case.
+    '''
+    if resultCache is not None:
+        cached = resultCache.get(case)
+        if cached is not None:
+            caseGrade, caseReport = cached
+            label, rest = caseReport.split("\n", maxsplit = 1)
+            return caseGrade, f"{label}\n[INFO] The result is reused from a previous run.\n{rest}", None
+    outputFile, checkers = workers.get()
+    try:
+        report = StringIO()
+        caseGrade, caseStats, reproducible = evaluate(testCase = case,
+                                                      testSubject = testSubject,
+                                                      checker = checkers[case.checker],
+                                                      outputFile = outputFile,
+                                                      report = report)
+    finally:
+        workers.put((outputFile, checkers))
+    # A timed out or killed run, or a failed checker run, may not recur for the submission.
+    if resultCache is not None and reproducible:
+        resultCache.put(case, caseGrade, report.getvalue())
+    return caseGrade, report.getvalue(), caseStats
+
+def reportCheckerStats(*, allStats : Dict[str, Dict[str, float]], report : TextIO):
+    '''
+    Reports the counters of the checker for the test cases of a submission, summed over them, and
+    appends them to CHECKER_STATS_FILE.
+    '''
+    if len(allStats) > 0:
+        totalStats = {key : (max if key == "peakBufferBytes" else sum)(
+                                stats.get(key, 0) for stats in allStats.values())
+                      for key in next(iter(allStats.values()))}
+        print(f"[INFO] Checker counters in total, over {len(allStats)} test cases:", file = report)
+        printCheckerStats(stats = totalStats, report = report)
+        print(file = report)
+        if CHECKER_STATS_FILE is not None:
+            with open(CHECKER_STATS_FILE, "a", encoding = "utf-8") as stream:
+                print(dumps({"time" : time(), "total" : totalStats, "cases" : allStats}),
+                      file = stream)
+
+def gradeSubmission():
+    '''Grades the submission in the current directory, printing the report to the standard output.'''
+    # Prepare checkers.
+    cases = getTestCases(totalGrade = TOTAL_GRADE)
+    checkers = prepareCheckers(cases)
     # Prepare test subject.
-    testSubject = ExecutableFromSources(name = EXECUTABLE_NAME,
-                                        sources = SOURCE_FILES,
-                                        compiler = COMPILER,
-                                        flags = COMPILER_FLAGS,
-                                        compilationTimeout = COMPILER_TIMEOUT,
-                                        delayErrorToExecution = True)
-    # Evaluate.
+    testSubject = prepareTestSubject(directory = ".", report = stdout)
+    # Prepare the workers, each with its own output file and checkers.
+    workerCount = PARALLEL_WORKERS if PARALLEL_WORKERS > 0 else len(sched_getaffinity(0))
+    workerCount = max(1, min(workerCount, len(cases)))
+    workers, servers = prepareWorkers(workerCount = workerCount, checkers = checkers)
+    #
+    resultCache = None if RESULT_CACHE_DIRECTORY is None \
+                  else ResultCache.create(directory = RESULT_CACHE_DIRECTORY,
+                                          testSubject = testSubject,
+                                          checkers = checkers)
+    # Evaluate from the longest test case, printing the reports in the order of the test cases.
     grade = 0
-    for case in getTestCases(totalGrade = TOTAL_GRADE):
-        grade = grade + evaluate(testCase = case,
-                                 testSubject = testSubject,
-                                 checker = checker)
+    allStats : Dict[str, Dict[str, float]] = {}
+    try:
+        with ThreadPoolExecutor(max_workers = workerCount) as pool:
+            futures = {case : pool.submit(evaluateOnWorker,
+                                          case = case,
+                                          testSubject = testSubject,
+                                          resultCache = resultCache,
+                                          workers = workers)
+                       for case in schedulingOrder(cases)}
+            results = (futures[case].result() for case in cases)
+            for case, (caseGrade, caseReport, caseStats) in zip(cases, results):
+                print(caseReport, end = "", flush = True)
+                grade = grade + caseGrade
+                if caseStats is not None:
+                    allStats[case.label] = caseStats
+    finally:
+        for server in servers:
+            server.close()
+    # Report the counters of the checker, summed over the test cases.
+    reportCheckerStats(allStats = allStats, report = stdout)
     # Convey the overall grade.
     conveyGrade(grade = grade, totalGrade = TOTAL_GRADE)
 
+def gradeBatch(directories : List[str]):
+    '''
+    Grades the submissions in the given directories against the test cases in the current directory
+    (see BATCH_REPORT_FILE). The checkers are compiled, the test cases are read and the checker
+    servers are started once for all of them. The test subjects are compiled in parallel, and then the
+    runs of all submissions on all test cases are taken by the workers from a single queue, from the
+    longest test case (see schedulingOrder), so that no worker is idle while any run is left,
+    regardless of how the slow runs are spread over the submissions.
+    Each submission gets its report and its vpl_execution as if it were graded on its own.
+    '''
+    for directory in directories:
+        assert isdir(directory), f"{directory} is not a directory."
+    cases = getTestCases(totalGrade = TOTAL_GRADE)
+    checkers = prepareCheckers(cases)
+    workerCount = PARALLEL_WORKERS if PARALLEL_WORKERS > 0 else len(sched_getaffinity(0))
+    workerCount = max(1, min(workerCount, len(cases) * len(directories)))
+    workers, servers = prepareWorkers(workerCount = workerCount, checkers = checkers)
+    #
+    def prepareSubmission(directory : str) -> Tuple[ExecutableFromSources, Optional[ResultCache],
+                                                    StringIO]:
+        report = StringIO()
+        testSubject = prepareTestSubject(directory = directory, report = report)
+        resultCache = None if RESULT_CACHE_DIRECTORY is None \
+                      else ResultCache.create(directory = RESULT_CACHE_DIRECTORY,
+                                              testSubject = testSubject,
+                                              checkers = checkers)
+        return testSubject, resultCache, report
+    # Evaluate from the longest test case, completing the reports in the order of the submissions.
+    try:
+        with ThreadPoolExecutor(max_workers = workerCount) as pool:
+            submissions = list(pool.map(prepareSubmission, directories))
+            futures = {(index, case) : pool.submit(evaluateOnWorker,
+                                                   case = case,
+                                                   testSubject = testSubject,
+                                                   resultCache = resultCache,
+                                                   workers = workers)
+                       for case in schedulingOrder(cases)
+                       for index, (testSubject, resultCache, _) in enumerate(submissions)}
+            for index, (directory, (_, _, report)) in enumerate(zip(directories, submissions)):
+                grade = 0
+                allStats : Dict[str, Dict[str, float]] = {}
+                for case in cases:
+                    caseGrade, caseReport, caseStats = futures[(index, case)].result()
+                    print(caseReport, end = "", file = report)
+                    grade = grade + caseGrade
+                    if caseStats is not None:
+                        allStats[case.label] = caseStats
+                reportCheckerStats(allStats = allStats, report = report)
+                conveyGrade(grade = grade, totalGrade = TOTAL_GRADE, directory = directory,
+                            report = report)
+                with open(join(directory, BATCH_REPORT_FILE), "w", encoding = "utf-8") as stream:
+                    stream.write(report.getvalue())
+                print(f"[GRADE] {directory}: {grade:.2f} / {TOTAL_GRADE:.2f}", flush = True)
+    finally:
+        for server in servers:
+            server.close()
+
+def main():
+    '''Main function.'''
+    if len(argv) > 1 and argv[1] == "--batch":
+        assert len(argv) > 2, "There are no submission directories."
+        gradeBatch(argv[2:])
+    else:
+        gradeSubmission()
+
 try:
     main()
 # TODO: How do I (and should I) catch every exception in here?